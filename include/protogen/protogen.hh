@@ -43,6 +43,10 @@ namespace protogen {
 // If no custom name is provided, the JSON field and the C++ field name will be the same.
 #define PROTOGEN_O_NAME                    "name"
 
+// Decode a message field only when it is first accessed (true) or during the deserialization
+// of the parent message (false). The default value is false.
+#define PROTOGEN_O_LAZY                    "lazy"
+
 class Generator
 {
     public:
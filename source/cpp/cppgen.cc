@@ -15,6 +15,7 @@
  */
 
 #include <algorithm>
+#include <map>
 #include <unordered_set>
 #include <vector>
 #include <cmake.hh>
@@ -25,6 +26,7 @@
 #include <auto-json-base64.hh>
 #include <auto-json-number.hh>
 #include <auto-json-string.hh>
+#include <auto-json-stream.hh>
 #include <protogen/protogen.hh>
 #include "../printer.hh"
 #include <sstream>
@@ -166,6 +168,8 @@ static std::string fieldNativeType( const Field &field, bool useLists )
     }
 }
 
+static bool is_lazy( const Field &field );
+
 static void generateNamespace( GeneratorContext &ctx, const Message &message, bool opening )
 {
     if (message.package.empty()) return;
@@ -196,6 +200,8 @@ static void generateModel( GeneratorContext &ctx, const Message &message )
     for (auto field : message.fields)
     {
         auto type = fieldNativeType(field, ctx.cpp_use_lists);
+        if (is_lazy(field))
+            type = Printer::format("protogen$1$::lazy_field<$2$>", PROTOGEN_VERSION_NAMING, type);
         ctx.printer("\t\t$1$ $2$;\n", type, field.name);
     }
     ctx.printer("\t};\n");
@@ -250,6 +256,15 @@ static bool is_transient( const Field &field )
     return get_option(field.options, PROTOGEN_O_TRANSIENT, false);
 }
 
+static bool is_lazy( const Field &field )
+{
+    if (!get_option(field.options, PROTOGEN_O_LAZY, false))
+        return false;
+    if (field.type.id != protogen::TYPE_MESSAGE || field.type.repeated)
+        throw exception("option '" + std::string(PROTOGEN_O_LAZY) + "' in the field '" + field.name + "' requires a non-repeated message type", 1, 1);
+    return true;
+}
+
 static std::string get_json_name( const Field &field )
 {
     auto name = get_option(field.options, PROTOGEN_O_NAME, field.name);
@@ -282,6 +297,29 @@ static void generate_function__read_field( GeneratorContext &ctx, const Message
     ctx.printer(CODE_JSON__READ_FIELD__FOOTER);
 }
 
+static void generate_function__validate_field( GeneratorContext &ctx, const Message &message, const std::string &typeName,
+    bool is_persistent )
+{
+    if (message.fields.size() == 0 || !is_persistent)
+    {
+        ctx.printer(CODE_JSON__VALIDATE_FIELD__EMPTY);
+        return;
+    }
+
+    ctx.printer(CODE_JSON__VALIDATE_FIELD__HEADER);
+
+    int i = 0;
+    for (auto field : message.fields)
+    {
+        if (is_transient(field))
+            continue;
+        ctx.printer(CODE_JSON__VALIDATE_FIELD__ITEM, i, typeName, field.name);
+        ++i;
+    }
+
+    ctx.printer(CODE_JSON__VALIDATE_FIELD__FOOTER);
+}
+
 static void generate_function__write( GeneratorContext &ctx, const Message &message, const std::string &typeName,
     bool is_persistent )
 {
@@ -293,20 +331,35 @@ static void generate_function__write( GeneratorContext &ctx, const Message &mess
 
     ctx.printer(CODE_JSON__WRITE__HEADER, typeName, PROTOGEN_VERSION_NAMING);
 
-    int i = 0;
+    // every key is written with the preceding comma and the colon in a single append
+    std::vector<std::string> labels;
     for (auto field : message.fields)
     {
         if (is_transient(field))
             continue;
-        auto name = get_json_name(field);
+        labels.push_back(ctx.number_names ? std::to_string(field.index) : get_json_name(field));
+    }
+    if (ctx.obfuscate_strings)
+    {
+        ctx.printer(CODE_JSON__WRITE__KEYS_HEADER);
+        for (const auto &label : labels)
+            ctx.printer(CODE_JSON__WRITE__KEYS_ITEM, obfuscate(label), label.length());
+        ctx.printer(CODE_JSON__WRITE__KEYS_FOOTER);
+    }
 
-        std::string label = ctx.number_names ? std::to_string(field.index) : name;
+    size_t i = 0;
+    for (auto field : message.fields)
+    {
+        if (is_transient(field))
+            continue;
+        const auto &label = labels[i];
         if (ctx.obfuscate_strings)
-            label = Printer::format("reveal(\"$1$\")", obfuscate(label));
+        {
+            auto key = "KEYS[" + std::to_string(i) + "]";
+            ctx.printer(CODE_JSON__WRITE__ITEM, field.name, key + ".data()", key + ".size()");
+        }
         else
-            label = Printer::format("\"$1$\"", label);
-
-        ctx.printer(CODE_JSON__WRITE__ITEM, field.name, label);
+            ctx.printer(CODE_JSON__WRITE__ITEM, field.name, "\",\\\"" + label + "\\\":\"", label.length() + 4);
         ++i;
     }
 
@@ -393,6 +446,30 @@ static void generate_function__swap( GeneratorContext &ctx, const Message &messa
     ctx.printer(CODE_JSON__SWAP__FOOTER);
 }
 
+struct FieldLabel
+{
+    std::string name;
+    int index;
+};
+
+// Returns the byte position that splits the labels (all with the same length) in most groups
+static size_t best_discriminant( const std::vector<FieldLabel> &labels )
+{
+    size_t best = 0, count = 0;
+    for (size_t i = 0, t = labels[0].name.length(); i < t; ++i)
+    {
+        std::unordered_set<char> values;
+        for (const auto &label : labels)
+            values.insert(label.name[i]);
+        if (values.size() > count)
+        {
+            best = i;
+            count = values.size();
+        }
+    }
+    return best;
+}
+
 static void generate_function__index( GeneratorContext &ctx, const Message &message, bool is_persistent )
 {
     if (message.fields.size() == 0 || !is_persistent)
@@ -401,25 +478,67 @@ static void generate_function__index( GeneratorContext &ctx, const Message &mess
         return;
     }
 
-    if (ctx.obfuscate_strings)
-        ctx.printer(CODE_JSON__INDEX__HEADER_OBF);
-    else
-        ctx.printer(CODE_JSON__INDEX__HEADER);
-
+    // group labels by length
+    std::map<size_t, std::vector<FieldLabel>> groups;
     int i = 0;
     for (auto field : message.fields)
     {
         if (is_transient(field))
             continue;
         auto name = get_json_name(field);
-
         std::string label = ctx.number_names ? std::to_string(field.index) : name;
-        if (ctx.obfuscate_strings)
-            label = obfuscate(label);
-        ctx.printer(CODE_JSON__INDEX__ITEM, label, i);
+        groups[label.length()].push_back({label, i});
         ++i;
     }
 
+    // labels in serialization order for speculative matching
+    std::vector<std::string> ordered(i);
+    for (const auto &group : groups)
+        for (const auto &label : group.second)
+            ordered[label.index] = label.name;
+    ctx.printer(CODE_JSON__INDEX__HEADER);
+    for (const auto &label : ordered)
+        ctx.printer(CODE_JSON__INDEX__LABEL, ctx.obfuscate_strings ? obfuscate(label) : label, label.length());
+    ctx.printer(ctx.obfuscate_strings ? CODE_JSON__INDEX__SPECULATE_OBF : CODE_JSON__INDEX__SPECULATE, i);
+
+    for (const auto &group : groups)
+    {
+        const auto &labels = group.second;
+        ctx.printer(CODE_JSON__INDEX__SIZE, group.first);
+
+        if (ctx.obfuscate_strings)
+        {
+            // compare without revealing the labels
+            for (const auto &label : labels)
+                ctx.printer(CODE_JSON__INDEX__ITEM_OBF, obfuscate(label.name), label.name.length(), label.index);
+        }
+        else
+        if (labels.size() > 2)
+        {
+            // dispatch on the byte that best separates the labels
+            size_t pos = best_discriminant(labels);
+            std::map<int, std::vector<FieldLabel>> cases;
+            for (const auto &label : labels)
+                cases[(unsigned char) label.name[pos]].push_back(label);
+
+            ctx.printer(CODE_JSON__INDEX__BYTE_HEADER, pos);
+            for (const auto &item : cases)
+            {
+                ctx.printer(CODE_JSON__INDEX__BYTE, item.first);
+                for (const auto &label : item.second)
+                    ctx.printer(CODE_JSON__INDEX__BYTE_ITEM, label.name, label.name.length(), label.index);
+                ctx.printer(CODE_JSON__INDEX__BYTE_END);
+            }
+            ctx.printer(CODE_JSON__INDEX__BYTE_FOOTER);
+            continue;
+        }
+        else
+        {
+            for (const auto &label : labels)
+                ctx.printer(CODE_JSON__INDEX__ITEM, label.name, label.name.length(), label.index);
+        }
+        ctx.printer(CODE_JSON__INDEX__SIZE_FOOTER);
+    }
     ctx.printer(CODE_JSON__INDEX__FOOTER);
 }
 
@@ -439,6 +558,7 @@ static void generateModelWrapper( GeneratorContext &ctx, const Message &message
 
     ctx.printer(CODE_JSON_MODEL__HEADER, PROTOGEN_VERSION_NAMING, typeName);
     generate_function__read_field(ctx, message, typeName, is_persistent);
+    generate_function__validate_field(ctx, message, typeName, is_persistent);
     generate_function__write(ctx, message, typeName, is_persistent);
     generate_function__empty(ctx, message, typeName);
     generate_function__clear(ctx, message, typeName);
@@ -573,6 +693,7 @@ static void generateInclusions( GeneratorContext &ctx )
         ctx.printer(GENERATED__json_number_hh);
     if (has_string)
         ctx.printer(GENERATED__json_string_hh);
+    ctx.printer(GENERATED__json_stream_hh);
 }
 
 static void generateModel( GeneratorContext &ctx )
@@ -21,60 +21,66 @@
 
 namespace protogen_X_Y_Z {
 
-template<typename T, typename _ = void>
-struct is_container : std::false_type {};
-
-template<typename... Ts>
-struct is_container_helper {};
-
-template<typename T>
-struct is_container<
-        T,
-        typename std::conditional<
-            false,
-            is_container_helper<
-                typename T::value_type,
-                typename T::size_type,
-                typename T::allocator_type,
-                typename T::iterator,
-                typename T::const_iterator,
-                decltype(std::declval<T>().size()),
-                decltype(std::declval<T>().begin()),
-                decltype(std::declval<T>().end()),
-                decltype(std::declval<T>().clear()),
-                decltype(std::declval<T>().empty())
-                >,
-            void
-            >::type
-        > : public std::true_type {};
-
 template<typename T>
 struct json<T, typename std::enable_if<is_container<T>::value>::type >
 {
+    // The elements are decoded by 'read_frames'
     static int read( json_context &ctx, T &value )
+    {
+        int result = open(ctx);
+        if (result != PGR_OK) return result;
+        return push_frame(ctx, read_frame, &value, true, drop_element);
+    }
+    static int validate( json_context &ctx )
+    {
+        int result = open(ctx);
+        if (result != PGR_OK) return result;
+        return push_frame(ctx, validate_frame, nullptr, true);
+    }
+    static int open( json_context &ctx )
     {
         if (ctx.tok->peek().id == token_id::NIL) return PGR_NIL;
+        if (too_deep(ctx))
+            return ctx.tok->error(error_code::PGERR_TOO_DEEP, "too many nesting levels");
         if (!ctx.tok->expect(token_id::ARRS))
             return ctx.tok->error(error_code::PGERR_INVALID_ARRAY, "invalid array");
-        if (!ctx.tok->expect(token_id::ARRE))
-        {
-            while (true)
-            {
-                typename T::value_type temp;
-                int result = json<typename T::value_type>::read(ctx, temp);
-                if (result == PGR_ERROR) return result;
-                if (result == PGR_OK) value.push_back(temp);
-
-                if (!ctx.tok->expect(token_id::COMMA))
-                {
-                    if (ctx.tok->expect(token_id::ARRE))
-                        break;
-                    return ctx.tok->error(error_code::PGERR_INVALID_ARRAY, "invalid array");
-                }
-            }
-        }
         return PGR_OK;
     }
+    static int read_frame( json_context &ctx, const char *name, size_t size, int &hint, void *value )
+    {
+        (void) name; (void) size; (void) hint;
+        return read_element(ctx, *static_cast<T*>(value));
+    }
+    static int validate_frame( json_context &ctx, const char *name, size_t size, int &hint, void *value )
+    {
+        (void) name; (void) size; (void) hint; (void) value;
+        return json<typename T::value_type>::validate(ctx);
+    }
+    static void drop_element( void *value )
+    {
+        static_cast<T*>(value)->pop_back();
+    }
+    // Decodes the element in place, without copies. Elements pushed to the frame stack stay in
+    // the container and are decoded later (PGR_PUSH).
+    template<typename C = T, typename std::enable_if<std::is_same<typename C::reference, typename C::value_type&>::value, int>::type = 0>
+    static int read_element( json_context &ctx, C &value )
+    {
+        value.emplace_back();
+        int result = json<typename C::value_type>::read(ctx, value.back());
+        if (result == PGR_NIL || result == PGR_ERROR) value.pop_back();
+        return result;
+    }
+    // Containers with proxy references (e.g. 'std::vector<bool>'). The element is a temporary, so
+    // it is decoded right away.
+    template<typename C = T, typename std::enable_if<!std::is_same<typename C::reference, typename C::value_type&>::value, int>::type = 0>
+    static int read_element( json_context &ctx, C &value )
+    {
+        ctx.nested = false;
+        typename C::value_type temp = typename C::value_type();
+        int result = json<typename C::value_type>::read(ctx, temp);
+        if (result == PGR_OK) value.push_back(std::move(temp));
+        return result;
+    }
     static int write( json_context &ctx, const T &value )
     {
         (*ctx.os) <<  '[';
@@ -100,40 +106,38 @@ struct json<T, typename std::enable_if<is_container<T>::value>::type >
 template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
 bool deserialize_array( T& container, protogen_X_Y_Z::istream& in, protogen_X_Y_Z::Parameters *params = nullptr )
 {
-    protogen_X_Y_Z::json_context ctx;
-    if (params != nullptr) {
-        params->error.clear();
-        ctx.params = *params;
-    }
-    protogen_X_Y_Z::tokenizer tok(in, ctx.params);
-    ctx.tok = &tok;
-    int result = json<T>::read(ctx, container);
-    if (result == protogen_X_Y_Z::PGR_OK) return true;
-    if (params != nullptr) params->error = std::move(ctx.params.error);
-    return false;
+    return read_document< json<T> >(container, params, in);
 }
 
 template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
-bool deserialize_array( T& container, const std::string &in, Parameters *params = nullptr )
+bool deserialize_array( T& container, const char *in, size_t len, Parameters *params = nullptr )
 {
-    iterator_istream<std::string::const_iterator> is(in.begin(), in.end());
-    return deserialize_array(container, is, params);
+    return read_document< json<T> >(container, params, in, in + len);
 }
 
 template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
-bool deserialize_array( T& container, const char *in, size_t len, Parameters *params = nullptr )
+bool deserialize_array( T& container, const std::string &in, Parameters *params = nullptr )
 {
-    auto begin = mem_iterator<char>(in, len);
-    auto end = mem_iterator<char>(in + len, 0);
-    iterator_istream<mem_iterator<char>> is(begin, end);
-    return deserialize_array(container, is, params);
+    return deserialize_array(container, in.data(), in.size(), params);
 }
 
 template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
 bool deserialize_array( T& container, const std::vector<char> &in, Parameters *params = nullptr )
 {
-    iterator_istream<std::vector<char>::const_iterator> is(in.begin(), in.end());
-    return deserialize_array(container, is, params);
+    return deserialize_array(container, in.data(), in.size(), params);
+}
+
+template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
+bool deserialize_array_file( T& container, const std::string &path, Parameters *params = nullptr )
+{
+    mapped_file file;
+    if (!file.open(path.c_str()))
+    {
+        if (params != nullptr)
+            params->error = ErrorInfo(error_code::PGERR_INVALID_FILE, "unable to read the file", 0, 0);
+        return false;
+    }
+    return deserialize_array(container, file.data(), file.size(), params);
 }
 
 //
@@ -141,7 +145,7 @@ bool deserialize_array( T& container, const std::vector<char> &in, Parameters *p
 //
 
 template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
-bool serialize_array( const T& container, protogen_X_Y_Z::ostream &out, protogen_X_Y_Z::Parameters *params = nullptr )
+bool serialize_array( const T& container, protogen_X_Y_Z::output_buffer &out, protogen_X_Y_Z::Parameters *params = nullptr )
 {
     protogen_X_Y_Z::json_context ctx;
     ctx.os = &out;
@@ -158,18 +162,21 @@ bool serialize_array( const T& container, protogen_X_Y_Z::ostream &out, protogen
 template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
 bool serialize_array( const T& container, std::string &out, Parameters *params = nullptr )
 {
-    typedef std::back_insert_iterator<std::string> ittype;
-    ittype begin(out);
-    iterator_ostream<ittype> os(begin);
+    output_buffer os(out);
+    return serialize_array(container, os, params);
+}
+
+template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
+bool serialize_array( const T& container, protogen_X_Y_Z::ostream &out, Parameters *params = nullptr )
+{
+    output_buffer os(out);
     return serialize_array(container, os, params);
 }
 
 template<typename T, typename std::enable_if<is_container<T>::value, int>::type = 0>
 bool serialize_array( const T& container, std::vector<char> &out, Parameters *params = nullptr )
 {
-    typedef std::back_insert_iterator<std::vector<char>> ittype;
-    ittype begin(out);
-    iterator_ostream<ittype> os(begin);
+    output_buffer os(out);
     return serialize_array(container, os, params);
 }
 
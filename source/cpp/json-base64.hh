@@ -37,6 +37,22 @@ struct json< std::vector<uint8_t> >
         if (ch == '=') return 64;
         return 0;
     }
+    // Checks the alphabet, the length and the padding of the base64 data
+    static bool is_base64( const char *data, size_t size )
+    {
+        if (size % 4 != 0) return false;
+        for (size_t i = 0; i < size; ++i)
+        {
+            char c = data[i];
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/')
+                continue;
+            // up to two padding characters at the end
+            if (c == '=' && i + 2 >= size && (i + 1 == size || data[i + 1] == '='))
+                continue;
+            return false;
+        }
+        return true;
+    }
     static int write( json_context &ctx, const std::vector<uint8_t> &value )
     {
         static const char *B64_SYMBOLS = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -81,22 +97,24 @@ struct json< std::vector<uint8_t> >
 
         size_t k = 0;
         int s[4];
-        std::string text = ctx.tok->peek().value;
-        ctx.tok->next();
-        const char *ptr = text.c_str();
+        const auto &tt = ctx.tok->peek();
+        const char *ptr = tt.data();
+        const char *end = ptr + tt.size();
+        if (!is_base64(ptr, tt.size()))
+            return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid base64 data");
 
         while (true)
         {
             // read 4 characters
             for (size_t j = 0; j < 4; ++j)
             {
-                int ch = *ptr++;
-                if (ch == 0)
+                if (ptr == end)
                 {
-                    if (j != 0) ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid base64 data");
+                    if (j != 0) return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid base64 data");
+                    ctx.tok->next();
                     return PGR_OK;
                 }
-                s[j] = b64_int(ch);
+                s[j] = b64_int(*ptr++);
             }
             // decode base64 tuple
             value.push_back( (uint8_t) (((s[0] & 0xFF) << 2 ) | ((s[1] & 0x30) >> 4)) );
@@ -115,6 +133,17 @@ struct json< std::vector<uint8_t> >
                 k+=1;
         }
     }
+    static int validate( json_context &ctx )
+    {
+        if (ctx.tok->peek().id == token_id::NIL) return PGR_NIL;
+        if (ctx.tok->peek().id != token_id::STRING)
+            return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid string");
+        const auto &tt = ctx.tok->peek();
+        if (!is_base64(tt.data(), tt.size()))
+            return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid base64 data");
+        ctx.tok->next();
+        return PGR_OK;
+    }
     static bool empty( const std::vector<uint8_t> &value ) { return value.empty(); }
     static void clear( std::vector<uint8_t> &value ) { value.clear(); }
     static bool equal( const std::vector<uint8_t> &a, const std::vector<uint8_t> &b ) { return a == b; }
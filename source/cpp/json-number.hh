@@ -45,47 +45,317 @@ template<typename T> class field
         operator T() const { return this->value_; }
 };
 
-template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
-static T string_to_number( const std::string &text )
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64)
+#define PROTOGEN_X_Y_Z__LITTLE_ENDIAN
+#endif
+
+static inline bool is_digit( char c )
+{
+    return c >= '0' && c <= '9';
+}
+
+#if defined(PROTOGEN_X_Y_Z__LITTLE_ENDIAN)
+// Checks whether the next 8 bytes are decimal digits
+static inline bool is_eight_digits( const char *ptr )
+{
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return ((value & 0xF0F0F0F0F0F0F0F0ULL) |
+        (((value + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+// Converts 8 decimal digits using SWAR
+static inline uint32_t parse_eight_digits( const char *ptr )
+{
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    value = (value & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    value = (value & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (uint32_t) ((value & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+}
+#endif
+
+// Parses the digits in [ptr, end) into 'value'. Stops at the first non-digit character.
+// Returns false if the value does not fit in 64 bits.
+static inline bool parse_digits( const char *&ptr, const char *end, uint64_t &value )
+{
+    const char *begin = ptr;
+#if defined(PROTOGEN_X_Y_Z__LITTLE_ENDIAN)
+    // up to 16 digits can not overflow
+    while (end - ptr >= 8 && ptr - begin <= 8 && is_eight_digits(ptr))
+    {
+        value = value * 100000000 + parse_eight_digits(ptr);
+        ptr += 8;
+    }
+#else
+    (void) begin;
+#endif
+    while (ptr < end && is_digit(*ptr))
+    {
+        uint64_t digit = (uint64_t) (*ptr - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) return false;
+        value = value * 10 + digit;
+        ++ptr;
+    }
+    return true;
+}
+
+// Decimal representation of a JSON number (mantissa * 10^exponent)
+struct decimal_number
+{
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    bool negative = false;
+    // Whether some significant digits did not fit in 'mantissa'
+    bool truncated = false;
+    // Whether the number has a fraction or an exponent
+    bool integer = true;
+};
+
+// Checks the JSON number syntax (RFC-8259 section 6) and decomposes the number
+static inline bool parse_decimal( const char *ptr, const char *end, decimal_number &number )
+{
+    static const uint64_t MAX_MANTISSA = 999999999999999999ULL;
+
+    if (ptr < end && *ptr == '-')
+    {
+        number.negative = true;
+        ++ptr;
+    }
+    if (ptr == end || !is_digit(*ptr)) return false;
+    if (*ptr == '0')
+    {
+        ++ptr;
+        if (ptr < end && is_digit(*ptr)) return false;
+    }
+    else
+    {
+        for (; ptr < end && is_digit(*ptr); ++ptr)
+        {
+            if (number.mantissa <= MAX_MANTISSA)
+                number.mantissa = number.mantissa * 10 + (uint64_t) (*ptr - '0');
+            else
+            {
+                ++number.exponent;
+                number.truncated |= *ptr != '0';
+            }
+        }
+    }
+    if (ptr < end && *ptr == '.')
+    {
+        number.integer = false;
+        ++ptr;
+        if (ptr == end || !is_digit(*ptr)) return false;
+        for (; ptr < end && is_digit(*ptr); ++ptr)
+        {
+            if (number.mantissa <= MAX_MANTISSA)
+            {
+                number.mantissa = number.mantissa * 10 + (uint64_t) (*ptr - '0');
+                --number.exponent;
+            }
+            else
+                number.truncated |= *ptr != '0';
+        }
+    }
+    if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+    {
+        number.integer = false;
+        ++ptr;
+        bool negative = false;
+        if (ptr < end && (*ptr == '+' || *ptr == '-')) negative = *ptr++ == '-';
+        if (ptr == end || !is_digit(*ptr)) return false;
+        int32_t exponent = 0;
+        for (; ptr < end && is_digit(*ptr); ++ptr)
+            if (exponent < 100000) exponent = exponent * 10 + (*ptr - '0');
+        number.exponent += negative ? -exponent : exponent;
+    }
+    return ptr == end;
+}
+
+// Locale-independent 'strtod' used when the fast path can not give the exact result
+template<typename T>
+static T string_to_number( const char *text )
 {
-    double value;
 #if defined(_WIN32) || defined(_WIN64)
     static _locale_t loc = _create_locale(LC_NUMERIC, "C");
     if (loc == nullptr) return 0;
-    value = _strtod_l(text.c_str(), nullptr, loc);
-#else
+    if (std::is_same<T, float>::value) return static_cast<T>(_strtof_l(text, nullptr, loc));
+    return static_cast<T>(_strtod_l(text, nullptr, loc));
+#elif defined(__USE_GNU) || defined(__APPLE__) || defined(__FreeBSD__)
     static locale_t loc = newlocale(LC_NUMERIC_MASK, "C", 0);
     if (loc == 0) return 0;
-#ifdef __USE_GNU
-    value = strtod_l(text.c_str(), nullptr, loc);
+    if (std::is_same<T, float>::value) return static_cast<T>(strtof_l(text, nullptr, loc));
+    return static_cast<T>(strtod_l(text, nullptr, loc));
 #else
-    locale_t old = uselocale(loc);
-    if (old == 0) return 0;
-    value = strtod(text.c_str(), nullptr);
-    uselocale(old);
-#endif
+    // without 'strtod_l', the decimal point is replaced by the one of the current locale instead
+    // of switching the locale of the thread
+    std::string temp;
+    const char *point = localeconv()->decimal_point;
+    if (point != nullptr && strcmp(point, ".") != 0 && *point != 0)
+    {
+        for (const char *ptr = text; *ptr != 0; ++ptr)
+        {
+            if (*ptr == '.')
+                temp += point;
+            else
+                temp += *ptr;
+        }
+        text = temp.c_str();
+    }
+    if (std::is_same<T, float>::value) return static_cast<T>(strtof(text, nullptr));
+    return static_cast<T>(strtod(text, nullptr));
 #endif
-    return static_cast<T>(value);
 }
 
-template<typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
-T string_to_number( const std::string &text )
+// Clinger's fast path: the mantissa and the power of ten are exact in 'F', so a single
+// multiplication or division gives the correctly rounded result. Single precision values are
+// computed in 'float' since rounding first to 'double' could round the result twice.
+template<typename F>
+static bool fast_number( const decimal_number &number, F &value )
 {
-#if defined(_WIN32) || defined(_WIN64)
-    return static_cast<T>( _strtoi64(text.c_str(), nullptr, 10) );
-#else
-    return static_cast<T>( strtol(text.c_str(), nullptr, 10) );
-#endif
+    // exact powers of ten representable in double precision (up to 1e10 in single precision)
+    static const double POWERS[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    static const uint64_t MAX_EXACT = 1ULL << std::numeric_limits<F>::digits;
+    static const int32_t MAX_POWER = std::is_same<F, float>::value ? 10 : 22;
+
+    if (number.truncated || number.mantissa > MAX_EXACT) return false;
+    uint64_t mantissa = number.mantissa;
+    int32_t exponent = number.exponent;
+    // move excess exponent into the mantissa while it stays exact
+    while (exponent > MAX_POWER && mantissa <= MAX_EXACT / 10)
+    {
+        mantissa *= 10;
+        --exponent;
+    }
+    if (exponent < -MAX_POWER || exponent > MAX_POWER) return false;
+    F result = (F) mantissa;
+    if (exponent < 0)
+        result /= (F) POWERS[-exponent];
+    else
+        result *= (F) POWERS[exponent];
+    value = number.negative ? -result : result;
+    return true;
 }
 
-template<typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, int>::type = 0>
-T string_to_number( const std::string &text )
+template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+static bool parse_number( const char *begin, const char *end, T &value )
 {
-#if defined(_WIN32) || defined(_WIN64)
-    return static_cast<T>( _strtoui64(text.c_str(), nullptr, 10) );
-#else
-    return static_cast<T>( strtoul(text.c_str(), nullptr, 10) );
-#endif
+    decimal_number number;
+    if (!parse_decimal(begin, end, number)) return false;
+
+    typename std::conditional<std::is_same<T, float>::value, float, double>::type result;
+    if (fast_number(number, result))
+    {
+        value = static_cast<T>(result);
+        return true;
+    }
+
+    char temp[64];
+    size_t size = (size_t) (end - begin);
+    if (size < sizeof(temp))
+    {
+        memcpy(temp, begin, size);
+        temp[size] = 0;
+        value = string_to_number<T>(temp);
+    }
+    else
+        value = string_to_number<T>(std::string(begin, end).c_str());
+    return true;
+}
+
+// Computes the magnitude of a number with fraction or exponent in integer arithmetic, so values
+// beyond 2^53 are not rounded. Returns false if the value is not integral or does not fit in
+// 64 bits.
+static inline bool parse_integral( const char *begin, const char *end, uint64_t &value )
+{
+    decimal_number number;
+    if (!parse_decimal(begin, end, number)) return false;
+
+    const char *ptr = begin;
+    if (*ptr == '-') ++ptr;
+    // digits of the integer part and the fraction, without the trailing zeros
+    value = 0;
+    int64_t exponent = 0, zeros = 0;
+    bool fraction = false;
+    for (; ptr < end && *ptr != 'e' && *ptr != 'E'; ++ptr)
+    {
+        if (*ptr == '.')
+        {
+            fraction = true;
+            continue;
+        }
+        if (fraction) --exponent;
+        if (*ptr == '0')
+        {
+            ++zeros;
+            continue;
+        }
+        // the zeros are kept apart until a non-zero digit follows them
+        for (; zeros > 0; --zeros)
+        {
+            if (value > std::numeric_limits<uint64_t>::max() / 10) return false;
+            value *= 10;
+        }
+        uint64_t digit = (uint64_t) (*ptr - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) return false;
+        value = value * 10 + digit;
+    }
+    if (value == 0) return true;
+    exponent += zeros;
+    if (ptr < end)
+    {
+        ++ptr;
+        bool negative = false;
+        if (*ptr == '+' || *ptr == '-') negative = *ptr++ == '-';
+        int64_t power = 0;
+        for (; ptr < end; ++ptr)
+            if (power < 100000) power = power * 10 + (*ptr - '0');
+        exponent += negative ? -power : power;
+    }
+    if (exponent < 0) return false;
+    for (; exponent > 0; --exponent)
+    {
+        if (value > std::numeric_limits<uint64_t>::max() / 10) return false;
+        value *= 10;
+    }
+    return true;
+}
+
+template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+static bool parse_number( const char *begin, const char *end, T &value )
+{
+    const char *ptr = begin;
+    bool negative = ptr < end && *ptr == '-';
+    if (negative) ++ptr;
+    const char *digits = ptr;
+    uint64_t result = 0;
+    bool fits = parse_digits(ptr, end, result);
+
+    if (!fits || ptr != end)
+    {
+        // fractions, exponents and large numbers are accepted if the value is integral
+        if (!parse_integral(begin, end, result)) return false;
+    }
+    else
+    if (ptr == digits || (*digits == '0' && ptr - digits > 1)) return false;
+
+    if (negative)
+    {
+        if (result == 0)
+            value = 0;
+        else
+        if (!std::is_signed<T>::value || result - 1 > (uint64_t) std::numeric_limits<T>::max())
+            return false;
+        else
+            value = static_cast<T>(-static_cast<T>(result - 1) - 1);
+    }
+    else
+    {
+        if (result > (uint64_t) std::numeric_limits<T>::max()) return false;
+        value = static_cast<T>(result);
+    }
+    return true;
 }
 
 template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
@@ -111,7 +381,22 @@ std::string number_to_string( const T &value )
 template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
 std::string number_to_string( const T &value )
 {
-    return std::to_string(value);
+    char buffer[MAX_INTEGER_SIZE];
+    char *end = buffer + MAX_INTEGER_SIZE;
+    return std::string(format_integer(value, end), end);
+}
+
+template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+void write_number( output_buffer &out, const T &value )
+{
+    out << number_to_string(value);
+}
+
+// Integers are formatted directly into the output
+template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+void write_number( output_buffer &out, const T &value )
+{
+    out << value;
 }
 
 template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
@@ -139,6 +424,7 @@ struct json<field<T>, typename std::enable_if<std::is_arithmetic<T>::value>::typ
             value = temp;
         return result;
     }
+    static int validate( json_context &ctx ) { return json<T>::validate(ctx); }
     static int write( json_context &ctx, const field<T> &value )
     {
         if (value.empty())
@@ -162,15 +448,19 @@ struct json<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
     {
         auto &tt = ctx.tok->peek();
         if (tt.id == token_id::NIL) return PGR_NIL;
-        if (tt.id != token_id::NUMBER)
+        if (tt.id != token_id::NUMBER || !parse_number(tt.data(), tt.data() + tt.size(), value))
             return ctx.tok->error(error_code::PGERR_INVALID_VALUE, "invalid numeric value");
-        value = string_to_number<T>(tt.value);
         ctx.tok->next();
         return PGR_OK;
     }
+    static int validate( json_context &ctx )
+    {
+        T value;
+        return read(ctx, value);
+    }
     static int write( json_context &ctx, const T &value )
     {
-        (*ctx.os) << number_to_string(value);
+        write_number(*ctx.os, value);
         return PGR_OK;
     }
     static bool empty( const T &value ) { return equal_number(value, (T) 0); }
@@ -192,6 +482,11 @@ struct json<bool, void>
         ctx.tok->next();
         return PGR_OK;
     }
+    static int validate( json_context &ctx )
+    {
+        bool value;
+        return read(ctx, value);
+    }
     static int write( json_context &ctx, const bool &value )
     {
         (*ctx.os) <<  (value ? "true" : "false");
@@ -0,0 +1,809 @@
+/*
+ * Copyright 2023-2024 Bruno Ribeiro <https://github.com/brunexgeek>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "json.hh" // AUTO-REMOVE
+
+#ifndef PROTOGEN_X_Y_Z__JSON_STREAM
+#define PROTOGEN_X_Y_Z__JSON_STREAM
+
+namespace protogen_X_Y_Z {
+
+enum decoder_status
+{
+    PGD_NEED_MORE,
+    PGD_DONE,
+    PGD_ERROR,
+};
+
+template<typename T, typename F>
+struct array_walker
+{
+    T &element;
+    F &callback;
+
+    static int read( json_context &ctx, array_walker &walker )
+    {
+        if (!ctx.tok->expect(token_id::ARRS))
+            return ctx.tok->error(error_code::PGERR_INVALID_ARRAY, "invalid array");
+        nesting_guard guard(ctx);
+        if (ctx.tok->expect(token_id::ARRE)) return PGR_OK;
+        while (true)
+        {
+            json<T>::clear(walker.element);
+            int result = json<T>::read(ctx, walker.element);
+            if (result == PGR_ERROR) return result;
+            if (result == PGR_OK && !walker.callback(walker.element)) return PGR_OK;
+
+            if (!ctx.tok->expect(token_id::COMMA))
+            {
+                if (ctx.tok->expect(token_id::ARRE))
+                    return PGR_OK;
+                return ctx.tok->error(error_code::PGERR_INVALID_ARRAY, "invalid array");
+            }
+        }
+    }
+};
+
+//
+// Streaming deserialization of arrays
+//
+// Each element of the top-level JSON array is decoded into 'element' (cleared before every item)
+// and passed to 'callback', which returns 'false' to stop early. Only one element is kept in
+// memory at a time. Null elements are skipped.
+//
+
+template<typename T, typename F>
+bool deserialize_array_each( T &element, F callback, protogen_X_Y_Z::istream &in, Parameters *params = nullptr )
+{
+    array_walker<T, F> walker{element, callback};
+    return read_document< array_walker<T, F> >(walker, params, in);
+}
+
+template<typename T, typename F>
+bool deserialize_array_each( T &element, F callback, const char *in, size_t len, Parameters *params = nullptr )
+{
+    array_walker<T, F> walker{element, callback};
+    return read_document< array_walker<T, F> >(walker, params, in, in + len);
+}
+
+template<typename T, typename F>
+bool deserialize_array_each( T &element, F callback, const std::string &in, Parameters *params = nullptr )
+{
+    return deserialize_array_each(element, callback, in.data(), in.size(), params);
+}
+
+// Reader for newline-delimited JSON (JSON Lines) streams with one message per line. The same
+// object, tokenizer and error context are reused for every line. Empty lines are ignored.
+template<typename T>
+class NdjsonReader
+{
+    public:
+        // Reads lines from the memory range [data, data + size)
+        NdjsonReader( const char *data, size_t size, const Parameters *params = nullptr,
+            bool skip_malformed = false ) : cur_(data), end_(data + size), in_(nullptr),
+            ctx_(make_context(params)), tok_(nullptr, nullptr, ctx_.params)
+        {
+            init(skip_malformed);
+        }
+
+        // Reads lines from a standard input stream
+        NdjsonReader( std::istream &in, const Parameters *params = nullptr, bool skip_malformed = false ) :
+            cur_(nullptr), end_(nullptr), in_(&in), ctx_(make_context(params)),
+            tok_(nullptr, nullptr, ctx_.params)
+        {
+            init(skip_malformed);
+        }
+
+        NdjsonReader( const NdjsonReader& ) = delete;
+        NdjsonReader &operator=( const NdjsonReader& ) = delete;
+
+        // Decodes the next message into 'value'. Returns false at the end of the input or, unless
+        // malformed lines are skipped, when a line cannot be decoded (see 'error').
+        bool next()
+        {
+            const char *begin, *end;
+            while (read_line(begin, end))
+            {
+                ++lines_;
+                json<T>::clear(value_);
+                ctx_.params.error.clear();
+                tok_.reset(begin, end);
+                if (tok_.peek().id == token_id::EOS) continue;
+
+                int result = json<T>::read(ctx_, value_);
+                if (result == PGR_OK && tok_.peek().id != token_id::EOS)
+                    result = tok_.error(error_code::PGERR_INVALID_VALUE, "unexpected data after the message");
+                else
+                if (result != PGR_OK && ctx_.params.error.code == error_code::PGERR_OK)
+                    result = tok_.error(error_code::PGERR_INVALID_VALUE, "invalid message");
+                if (result == PGR_OK)
+                {
+                    ++decoded_;
+                    return true;
+                }
+
+                // report the position in the stream
+                error_ = ctx_.params.error;
+                error_.line = (int) lines_;
+                ++skipped_;
+                if (!skip_malformed_) return false;
+            }
+            return false;
+        }
+
+        T &value() { return value_; }
+        const T &value() const { return value_; }
+        // Information about the last malformed line
+        const ErrorInfo &error() const { return error_; }
+        // Number of lines read, including empty and malformed ones
+        size_t lines() const { return lines_; }
+        // Number of messages decoded
+        size_t decoded() const { return decoded_; }
+        // Number of malformed lines
+        size_t skipped() const { return skipped_; }
+
+    protected:
+        T value_;
+        // Remaining memory input
+        const char *cur_, *end_;
+        std::istream *in_;
+        // Current line read from 'in_'
+        std::string line_;
+        json_context ctx_;
+        tokenizer tok_;
+        ErrorInfo error_;
+        bool skip_malformed_;
+        size_t lines_, decoded_, skipped_;
+
+        void init( bool skip_malformed )
+        {
+            ctx_.tok = &tok_;
+            skip_malformed_ = skip_malformed;
+            lines_ = decoded_ = skipped_ = 0;
+        }
+
+        bool read_line( const char *&begin, const char *&end )
+        {
+            if (in_ != nullptr)
+            {
+                if (!std::getline(*in_, line_)) return false;
+                begin = line_.data();
+                end = begin + line_.size();
+                return true;
+            }
+            if (cur_ == end_) return false;
+            begin = cur_;
+            end = (const char*) memchr(cur_, '\n', (size_t) (end_ - cur_));
+            if (end == nullptr)
+                cur_ = end = end_;
+            else
+                cur_ = end + 1;
+            return true;
+        }
+};
+
+// Writer for newline-delimited JSON (JSON Lines) streams. Each message is serialized in a single
+// line. Lines for streams and output buffers are built in a buffer that is reused between messages
+// and written with a single call; strings receive the lines directly.
+template<typename T>
+class NdjsonWriter
+{
+    public:
+        NdjsonWriter( ostream &out, const Parameters *params = nullptr ) : ctx_(make_context(params)),
+            out_(&out), stream_(nullptr), string_(nullptr), target_(nullptr), count_(0)
+        {
+        }
+
+        NdjsonWriter( std::ostream &out, const Parameters *params = nullptr ) : ctx_(make_context(params)),
+            out_(nullptr), stream_(&out), string_(nullptr), target_(nullptr), count_(0)
+        {
+        }
+
+        // Lines are appended to 'out'
+        NdjsonWriter( std::string &out, const Parameters *params = nullptr ) : ctx_(make_context(params)),
+            out_(nullptr), stream_(nullptr), string_(&out), target_(nullptr), count_(0)
+        {
+        }
+
+        NdjsonWriter( output_buffer &out, const Parameters *params = nullptr ) : ctx_(make_context(params)),
+            out_(nullptr), stream_(nullptr), string_(nullptr), target_(&out), count_(0)
+        {
+        }
+
+        NdjsonWriter( const NdjsonWriter& ) = delete;
+        NdjsonWriter &operator=( const NdjsonWriter& ) = delete;
+
+        bool write( const T &value )
+        {
+            ctx_.params.error.clear();
+            std::string &line = (string_ != nullptr) ? *string_ : buffer_;
+            if (string_ == nullptr) buffer_.clear();
+            size_t size = line.size();
+            bool failed;
+            {
+                output_buffer os(line);
+                ctx_.os = &os;
+                // errors in fields are only recorded in the context
+                failed = json<T>::write(ctx_, value) != PGR_OK || ctx_.params.error.code != PGERR_OK;
+                if (!failed) os << '\n';
+            }
+            ctx_.os = nullptr;
+            if (failed)
+            {
+                // drop the partial line
+                line.resize(size);
+                return false;
+            }
+            if (target_ != nullptr)
+                target_->append(buffer_.data(), buffer_.size());
+            else
+            if (out_ != nullptr)
+                *out_ << buffer_;
+            else
+            if (stream_ != nullptr)
+            {
+                stream_->write(buffer_.data(), (std::streamsize) buffer_.size());
+                if (!*stream_) return false;
+            }
+            ++count_;
+            return true;
+        }
+
+        // Information about the error of the last call to 'write'
+        const ErrorInfo &error() const { return ctx_.params.error; }
+        // Number of messages written
+        size_t count() const { return count_; }
+
+    protected:
+        json_context ctx_;
+        // Output, one of them not null
+        ostream *out_;
+        std::ostream *stream_;
+        std::string *string_;
+        output_buffer *target_;
+        // Line being written, except for strings
+        std::string buffer_;
+        size_t count_;
+};
+
+// Incremental decoder for JSON documents received in chunks of any size (e.g. from non-blocking
+// sockets). The decoder keeps partial tokens and the nesting of objects and arrays across calls
+// to 'feed' and reports framing errors as soon as they are received. Results and error positions
+// are the same as 'deserialize' gives for the whole document, except for malformed unknown values
+// with 'Parameters::structural_index' (their contents are not validated).
+//
+// 'T' can be any generated message or a container supported by 'deserialize_array'. Documents
+// are decoded member by member: each member of the top-level object (messages) or element of the
+// top-level array (containers) is decoded into 'value' as soon as its last byte is received, and
+// the bytes already decoded are released by a later call to 'feed' once they are at least half of
+// the buffer. Only the member or element being received is kept in memory (plus at most as many
+// decoded bytes), so a single large member (e.g. a nested message or a repeated field) is
+// buffered until it is complete.
+template<typename T>
+class PushDecoder
+{
+    public:
+        PushDecoder( const Parameters *params = nullptr ) : ctx_(make_context(params)),
+            tok_(nullptr, nullptr, lazy_position(ctx_.params)), scanned_(0), end_(0), element_(0),
+            consumed_(0), line_(1), column_(1), in_string_(false), escape_(false), first_(true),
+            hint_(0), status_(PGD_NEED_MORE)
+        {
+            ctx_.tok = &tok_;
+        }
+        PushDecoder( const PushDecoder& ) = delete;
+        PushDecoder &operator=( const PushDecoder& ) = delete;
+
+        // Appends a chunk of input. If the status is not PGD_NEED_MORE, the chunk is only
+        // buffered and will be processed after 'reset' is called.
+        decoder_status feed( const char *data, size_t size )
+        {
+            if (status_ == PGD_NEED_MORE) drop();
+            if (size > 0) buffer_.append(data, size);
+            if (status_ != PGD_NEED_MORE) return status_;
+
+            const char *base = buffer_.data();
+            const char *end = base + buffer_.size();
+            const char *ptr = base + scanned_;
+            while (ptr < end)
+            {
+                if (escape_)
+                {
+                    escape_ = false;
+                    ++ptr;
+                    continue;
+                }
+                if (in_string_)
+                {
+                    ptr = scan_string(ptr, end);
+                    if (ptr == end) break;
+                    char c = *ptr++;
+                    if (c == '\\')
+                        escape_ = true;
+                    else
+                    if (c == '"')
+                        in_string_ = false;
+                    continue;
+                }
+
+                char c = *ptr++;
+                switch (c)
+                {
+                    case '"':
+                        if (stack_.empty())
+                            return reject(ptr - 1, PGERR_INVALID_VALUE, "documents must be objects or arrays");
+                        in_string_ = true;
+                        break;
+                    case '{':
+                    case '[':
+                        stack_.push_back(c);
+                        if (stack_.size() == 1) element_ = (size_t) (ptr - base);
+                        break;
+                    case ',':
+                        if (stack_.size() == 1 && incremental())
+                        {
+                            if (!read_element(ptr - 1, false)) return status_;
+                            element_ = (size_t) (ptr - base);
+                        }
+                        else
+                        if (stack_.empty())
+                            return reject(ptr - 1, PGERR_INVALID_VALUE, "documents must be objects or arrays");
+                        break;
+                    case '}':
+                        if (stack_.empty() || stack_.back() != '{')
+                            return reject(ptr - 1, PGERR_INVALID_OBJECT, "invalid JSON object");
+                        if (stack_.size() == 1 && incremental() && !read_element(ptr - 1, true))
+                            return status_;
+                        stack_.pop_back();
+                        if (stack_.empty()) return complete(ptr, !is_container<T>::value);
+                        break;
+                    case ']':
+                        if (stack_.empty() || stack_.back() != '[')
+                            return reject(ptr - 1, PGERR_INVALID_ARRAY, "invalid array");
+                        if (stack_.size() == 1 && incremental() && !read_element(ptr - 1, true))
+                            return status_;
+                        stack_.pop_back();
+                        if (stack_.empty()) return complete(ptr, is_container<T>::value);
+                        break;
+                    case ' ':
+                    case '\t':
+                    case '\r':
+                    case '\n':
+                        break;
+                    default:
+                        if (stack_.empty())
+                            return reject(ptr - 1, PGERR_INVALID_VALUE, "documents must be objects or arrays");
+                }
+            }
+            scanned_ = buffer_.size();
+            return status_;
+        }
+
+        // Prepares the decoder for the next document. Bytes received after the end of the
+        // current document are kept and processed by the next call to 'feed'.
+        void reset()
+        {
+            buffer_.erase(0, end_);
+            scanned_ = end_ = element_ = consumed_ = 0;
+            line_ = column_ = 1;
+            stack_.clear();
+            in_string_ = escape_ = false;
+            first_ = true;
+            hint_ = 0;
+            status_ = PGD_NEED_MORE;
+            ctx_.params.error.clear();
+            json<T>::clear(value_);
+        }
+
+        decoder_status status() const { return status_; }
+        // Decoded value (valid when the status is PGD_DONE). It also holds the members or elements
+        // decoded so far while the status is PGD_NEED_MORE.
+        T &value() { return value_; }
+        const T &value() const { return value_; }
+        // Information about the error (valid when the status is PGD_ERROR)
+        const ErrorInfo &error() const { return ctx_.params.error; }
+        // Number of bytes kept in memory, including decoded bytes not released yet (see 'drop')
+        size_t buffered() const { return buffer_.size(); }
+
+    protected:
+        T value_;
+        // Context and tokenizer used to decode every member or element
+        json_context ctx_;
+        tokenizer tok_;
+        // Current document followed by bytes received after it
+        std::string buffer_;
+        // Open objects and arrays
+        std::vector<char> stack_;
+        // Bytes of 'buffer_' already scanned
+        size_t scanned_;
+        // End of the current document in 'buffer_' (after completion)
+        size_t end_;
+        // Beginning of the current member or element of the top-level value in 'buffer_'
+        size_t element_;
+        // Bytes at the beginning of 'buffer_' already decoded (i.e. the read offset)
+        size_t consumed_;
+        // Position in the document of the first byte of 'buffer_'
+        int line_, column_;
+        bool in_string_, escape_;
+        // Whether no member or element of the top-level value was decoded yet
+        bool first_;
+        // Field expected to come next in the top-level object (messages only)
+        int hint_;
+        // Keys of the top-level object that are not referenced in the input (messages only)
+        std::string name_;
+        decoder_status status_;
+
+        // Removes the bytes already decoded from the buffer once they are at least half of it, so
+        // each byte is moved a bounded number of times however small the chunks are
+        void drop()
+        {
+            if (consumed_ == 0 || consumed_ < buffer_.size() - consumed_) return;
+            int line, column;
+            locate(buffer_.data(), buffer_.data() + consumed_, line, column);
+            column_ = (line == 1) ? column_ + column - 1 : column;
+            line_ += line - 1;
+            buffer_.erase(0, consumed_);
+            scanned_ -= consumed_;
+            element_ -= consumed_;
+            consumed_ = 0;
+        }
+
+        // Errors are located from their offset in the buffer (see 'decode'), so the tokenizer
+        // does not need to track the position
+        static Parameters &lazy_position( Parameters &params )
+        {
+            params.lazy_position = true;
+            return params;
+        }
+
+        // Computes the position of 'ptr' in the document
+        void position( const char *ptr, int &line, int &column ) const
+        {
+            locate(buffer_.data(), ptr, line, column);
+            if (line == 1) column += column_ - 1;
+            line += line_ - 1;
+        }
+
+        // Whether the top-level value is decoded incrementally, i.e. it is an array decoded into a
+        // container or an object decoded into a message. Other documents are rejected when
+        // complete.
+        bool incremental() const
+        {
+            return stack_[0] == (is_container<T>::value ? '[' : '{');
+        }
+
+        // Decodes the member or element of the top-level value ending at 'ptr' (a comma or the
+        // closing bracket or brace)
+        bool read_element( const char *ptr, bool last )
+        {
+            const char *begin = buffer_.data() + element_;
+            while (begin < ptr && (*begin == ' ' || *begin == '\t' || *begin == '\r' || *begin == '\n'))
+                ++begin;
+            // only empty arrays and objects have no elements
+            if (begin == ptr && last && first_) return true;
+            // the comma or closing bracket is decoded too, so values are never followed by the
+            // end of the input (e.g. unknown members are skipped like in whole documents)
+            if (!decode(begin, ptr + 1, last)) return false;
+            first_ = false;
+            // the comma is dropped with the element
+            consumed_ = (size_t) (ptr - buffer_.data()) + (last ? 0 : 1);
+            return true;
+        }
+
+        // Decodes the member or element of the top-level value in [begin, end), followed by its
+        // terminator, or the whole document if it is not decoded incrementally. Errors are located
+        // from their offset in the buffer, like in 'deserialize'.
+        bool decode( const char *begin, const char *end, bool last )
+        {
+            bool part = !stack_.empty() && incremental();
+            ctx_.depth = part ? 1 : 0;
+            ctx_.mask_entry = 0;
+            tok_.reset(begin, end);
+            int result = part ? read_part(ctx_, last) : json<T>::read(ctx_, value_);
+            if (result != PGR_ERROR) return true;
+            ErrorInfo &error = ctx_.params.error;
+            if (error.line != 0 && tok_.error_position() != nullptr)
+                position(tok_.error_position(), error.line, error.column);
+            end_ = scanned_ = buffer_.size();
+            status_ = PGD_ERROR;
+            return false;
+        }
+
+        template<typename C = T, typename std::enable_if<is_container<C>::value, int>::type = 0>
+        int read_part( json_context &ctx, bool last )
+        {
+            int result = json<C>::read_element(ctx, value_);
+            if (result != PGR_ERROR && ctx.tok->peek().id != (last ? token_id::ARRE : token_id::COMMA))
+                result = ctx.tok->error(PGERR_INVALID_ARRAY, "invalid array");
+            return result;
+        }
+
+        template<typename C = T, typename std::enable_if<!is_container<C>::value, int>::type = 0>
+        int read_part( json_context &ctx, bool last )
+        {
+            int result = read_member(ctx, name_, hint_, [&ctx, this]( const char *name, size_t size, int &hint )
+                { return json<C>::read_field(ctx, name, size, hint, value_); });
+            if (result != PGR_ERROR && ctx.tok->peek().id != (last ? token_id::OBJE : token_id::COMMA))
+                result = ctx.tok->error(PGERR_INVALID_OBJECT, "invalid JSON object");
+            return result;
+        }
+
+        // Finishes the current document. Top-level values decoded incrementally are already in
+        // 'value_'.
+        decoder_status complete( const char *ptr, bool decoded )
+        {
+            end_ = scanned_ = (size_t) (ptr - buffer_.data());
+            if (decoded || read_document< json<T>, T >(value_, &ctx_.params, buffer_.data(), ptr))
+                status_ = PGD_DONE;
+            else
+            {
+                if (ctx_.params.error.code == PGERR_OK)
+                    set_error(ctx_.params.error, PGERR_INVALID_VALUE, "invalid JSON document");
+                status_ = PGD_ERROR;
+            }
+            return status_;
+        }
+
+        // Reports the framing error at 'ptr', unless the decoder finds an error before it (i.e. the
+        // error 'deserialize' would report)
+        decoder_status reject( const char *ptr, error_code code, const char *message )
+        {
+            const char *begin = buffer_.data();
+            if (!stack_.empty() && incremental()) begin += element_;
+            if (!decode(begin, ptr + 1, false)) return status_;
+            ctx_.params.error.clear();
+            return fail(ptr, code, message);
+        }
+
+        decoder_status fail( const char *ptr, error_code code, const char *message )
+        {
+            end_ = scanned_ = buffer_.size();
+            ctx_.params.error.code = code;
+            ctx_.params.error.message = message;
+            position(ptr, ctx_.params.error.line, ctx_.params.error.column);
+            return status_ = PGD_ERROR;
+        }
+};
+
+} // namespace protogen_X_Y_Z
+
+#endif // PROTOGEN_X_Y_Z__JSON_STREAM
+
+// Classes using threads are only available when 'PROTOGEN_X_Y_Z__THREADS' is defined before
+// including the generated headers
+#if defined(PROTOGEN_X_Y_Z__THREADS) && !defined(PROTOGEN_X_Y_Z__JSON_THREADS)
+#define PROTOGEN_X_Y_Z__JSON_THREADS
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+
+namespace protogen_X_Y_Z {
+
+// Parallel reader for newline-delimited JSON (JSON Lines) in memory. The input is split at line
+// boundaries into chunks which are decoded by worker threads. Messages are delivered to the
+// callback in the calling thread, in the original order or, if 'ordered' is false, as soon as
+// each chunk is decoded. At most a few chunks per thread are kept in memory at once.
+template<typename T>
+class ParallelNdjsonReader
+{
+    public:
+        // Zero threads means one per hardware thread
+        ParallelNdjsonReader( unsigned threads = 0, const Parameters *params = nullptr,
+            bool skip_malformed = false, bool ordered = true ) : threads_(threads),
+            skip_malformed_(skip_malformed), ordered_(ordered), lines_(0), decoded_(0), skipped_(0)
+        {
+            if (threads_ == 0) threads_ = std::thread::hardware_concurrency();
+            if (threads_ == 0) threads_ = 1;
+            if (params != nullptr) params_ = *params;
+            params_.error.clear();
+        }
+
+        // Decodes the lines in [data, data + size) and calls 'callback' with every message. The
+        // callback returns 'false' to stop. Returns false if a malformed line stopped the reader.
+        template<typename F>
+        bool read( const char *data, size_t size, F callback )
+        {
+            error_.clear();
+            lines_ = decoded_ = skipped_ = 0;
+            split(data, size);
+
+            stop_ = false;
+            next_ = pending_ = 0;
+            ready_.clear();
+            failure_ = nullptr;
+            worker_guard workers(*this);
+            for (unsigned i = 0; i < threads_ && i < chunks_.size(); ++i)
+                workers.threads.emplace_back(&ParallelNdjsonReader::work, this);
+
+            bool result = true;
+            size_t cursor = 0;
+            for (size_t count = 0; count < chunks_.size(); ++count)
+            {
+                chunk *item = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if (ordered_)
+                        cond_.wait(lock, [&]{ return failure_ || chunks_[cursor].ready; });
+                    else
+                    {
+                        cond_.wait(lock, [&]{ return failure_ || !ready_.empty(); });
+                        if (!failure_)
+                        {
+                            cursor = ready_.front();
+                            ready_.pop_front();
+                        }
+                    }
+                    if (!failure_) item = &chunks_[cursor++];
+                }
+                if (item == nullptr) break;
+
+                lines_ += item->lines;
+                decoded_ += item->values.size();
+                skipped_ += item->skipped;
+                bool proceed = true;
+                for (auto it = item->values.begin(); proceed && it != item->values.end(); ++it)
+                    proceed = callback(*it);
+                if (item->skipped > 0 && error_.code == error_code::PGERR_OK)
+                {
+                    // report the position in the whole input
+                    error_ = std::move(item->error);
+                    error_.line += (int) std::count(data, item->begin, '\n');
+                }
+                if (item->skipped > 0 && !skip_malformed_) proceed = result = false;
+                std::vector<T>().swap(item->values);
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                --pending_;
+                if (!proceed) stop_ = true;
+                cond_.notify_all();
+                if (!proceed) break;
+            }
+
+            workers.join();
+            chunks_.clear();
+            // exceptions thrown by the workers are raised in the calling thread
+            if (failure_)
+            {
+                std::exception_ptr failure = failure_;
+                failure_ = nullptr;
+                std::rethrow_exception(failure);
+            }
+            return result;
+        }
+
+        // Information about the first malformed line found
+        const ErrorInfo &error() const { return error_; }
+        // Number of lines delivered, including empty and malformed ones
+        size_t lines() const { return lines_; }
+        // Number of messages decoded
+        size_t decoded() const { return decoded_; }
+        // Number of malformed lines
+        size_t skipped() const { return skipped_; }
+
+    protected:
+        static const size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+        struct chunk
+        {
+            const char *begin, *end;
+            std::vector<T> values;
+            ErrorInfo error;
+            size_t lines, skipped;
+            bool ready;
+        };
+
+        unsigned threads_;
+        Parameters params_;
+        bool skip_malformed_, ordered_;
+        ErrorInfo error_;
+        size_t lines_, decoded_, skipped_;
+        std::vector<chunk> chunks_;
+        // Work state shared with the workers (protected by 'mutex_')
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::deque<size_t> ready_;
+        size_t next_, pending_;
+        bool stop_;
+        // First exception thrown by a worker
+        std::exception_ptr failure_;
+
+        // Stops and joins the workers on every exit path, including exceptions thrown by the
+        // callback or while starting the threads
+        struct worker_guard
+        {
+            ParallelNdjsonReader &owner;
+            std::vector<std::thread> threads;
+
+            worker_guard( ParallelNdjsonReader &owner ) : owner(owner) {}
+            ~worker_guard() { join(); }
+            void join()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(owner.mutex_);
+                    owner.stop_ = true;
+                }
+                owner.cond_.notify_all();
+                for (auto &thread : threads)
+                    if (thread.joinable()) thread.join();
+            }
+        };
+
+        void split( const char *data, size_t size )
+        {
+            size_t target = std::max((size_t) MIN_CHUNK_SIZE, size / (threads_ * 8) + 1);
+            const char *end = data + size;
+            chunks_.clear();
+            while (data < end)
+            {
+                const char *limit = ((size_t) (end - data) > target) ? data + target : end;
+                const char *ptr = (const char*) memchr(limit - 1, '\n', (size_t) (end - limit + 1));
+                ptr = (ptr == nullptr) ? end : ptr + 1;
+                chunks_.push_back(chunk{data, ptr, std::vector<T>(), ErrorInfo(), 0, 0, false});
+                data = ptr;
+            }
+        }
+
+        void work()
+        {
+            try
+            {
+                decode();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!failure_) failure_ = std::current_exception();
+                stop_ = true;
+                cond_.notify_all();
+            }
+        }
+
+        void decode()
+        {
+            // limit the number of chunks decoded but not delivered
+            const size_t window = threads_ * 4;
+            while (true)
+            {
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cond_.wait(lock, [&]{ return stop_ || next_ >= chunks_.size() || pending_ < window; });
+                    if (stop_ || next_ >= chunks_.size()) return;
+                    index = next_++;
+                    ++pending_;
+                }
+
+                chunk &item = chunks_[index];
+                NdjsonReader<T> reader(item.begin, (size_t) (item.end - item.begin), &params_, skip_malformed_);
+                while (reader.next())
+                    item.values.push_back(std::move(reader.value()));
+                item.lines = reader.lines();
+                item.skipped = reader.skipped();
+                if (item.skipped > 0) item.error = reader.error();
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                item.ready = true;
+                if (!ordered_) ready_.push_back(index);
+                cond_.notify_all();
+            }
+        }
+};
+
+} // namespace protogen_X_Y_Z
+
+#endif // PROTOGEN_X_Y_Z__JSON_THREADS
@@ -53,7 +53,7 @@ class string_field
         const value_type &operator *() const { return this->value_; }
 };
 
-static void write_escaped_utf8(internal::ostream *out, uint32_t codepoint)
+static void write_escaped_utf8(output_buffer *out, uint32_t codepoint)
 {
     char buffer[7];
     snprintf(buffer, sizeof(buffer), "\\u%04x", codepoint);
@@ -65,11 +65,21 @@ struct json<std::string, void>
 {
     static int read( json_context &ctx, std::string &value )
     {
-        auto tt = ctx.tok->peek();
+        auto &tt = ctx.tok->peek();
         if (tt.id == token_id::NIL) return PGR_NIL;
-        if (!ctx.tok->expect(token_id::STRING))
+        if (tt.id != token_id::STRING)
             return ctx.tok->error(error_code::PGERR_INVALID_VALUE, "invalid string value");
-        value = tt.value;
+        tt.take(value);
+        ctx.tok->next();
+        return PGR_OK;
+    }
+    static int validate( json_context &ctx )
+    {
+        auto &tt = ctx.tok->peek();
+        if (tt.id == token_id::NIL) return PGR_NIL;
+        if (tt.id != token_id::STRING)
+            return ctx.tok->error(error_code::PGERR_INVALID_VALUE, "invalid string value");
+        ctx.tok->next();
         return PGR_OK;
     }
     static int write( json_context &ctx, const std::string &value )
@@ -172,13 +182,12 @@ struct json<string_field, void>
 {
     static int read( json_context &ctx, string_field &value )
     {
-        std::string temp;
-        temp.clear();
-        int result = json<std::string, void>::read(ctx, temp);
-        value.empty(result == PGR_NIL);
-        value = temp;
+        int result = json<std::string, void>::read(ctx, *value);
+        // a JSON null leaves the field null
+        if (result != PGR_ERROR) value.empty(result == PGR_NIL);
         return result;
     }
+    static int validate( json_context &ctx ) { return json<std::string, void>::validate(ctx); }
     static int write( json_context &ctx, const string_field &value )
     {
         if (value.empty())
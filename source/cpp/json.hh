@@ -18,22 +18,101 @@
 #define PROTOGEN_X_Y_Z__JSON
 
 #include "protogen.hh" // AUTO-REMOVE
-#include <unordered_map> // used by 'field_index' functions
 
 namespace protogen_X_Y_Z {
 
 using namespace protogen_X_Y_Z::internal;
 
+struct json_context;
+
+// Object or array being decoded (see 'read_frames')
+struct decode_frame
+{
+    // Reads a member (objects) or an element (arrays) of 'object'
+    int (*read)( json_context &ctx, const char *name, size_t size, int &hint, void *object );
+    void *object;
+    // Removes the last element of 'object' (arrays), if it is still being decoded after an error
+    void (*drop)( void *object );
+    // Field mask state of the object (see 'read_selected')
+    const FieldMask *mask;
+    int mask_entry;
+    // Field expected to come next (objects only)
+    int hint;
+    bool array, first;
+    // Whether the last member or element was pushed to the stack and is still being decoded
+    bool pending;
+};
+
+// Stack of frames with room for the first levels in place, so most documents are decoded without
+// allocating memory. Deeper levels are kept in the heap.
+class frame_stack
+{
+    public:
+        frame_stack() : size_(0) {}
+        frame_stack( const frame_stack &that ) : size_(0) { *this = that; }
+        frame_stack &operator=( const frame_stack &that )
+        {
+            size_ = 0;
+            for (size_t i = 0; i < that.size_; ++i) push_back(that[i]);
+            return *this;
+        }
+        size_t size() const { return size_; }
+        decode_frame &operator[]( size_t index ) { return (index < LOCAL) ? local_[index] : heap_[index - LOCAL]; }
+        const decode_frame &operator[]( size_t index ) const { return (index < LOCAL) ? local_[index] : heap_[index - LOCAL]; }
+        void push_back( const decode_frame &frame )
+        {
+            if (size_ < LOCAL)
+                local_[size_] = frame;
+            else
+            if (size_ - LOCAL < heap_.size())
+                heap_[size_ - LOCAL] = frame;
+            else
+                heap_.push_back(frame);
+            ++size_;
+        }
+        void pop_back() { --size_; }
+        // Removes the frames from 'size' on (the heap memory is kept)
+        void truncate( size_t size ) { if (size < size_) size_ = size; }
+
+    protected:
+        static const size_t LOCAL = 16;
+        decode_frame local_[LOCAL];
+        std::vector<decode_frame> heap_;
+        size_t size_;
+};
+
 struct json_context
 {
     // Tokenizer object used for loading JSON during deserialization
     tokenizer *tok = nullptr;
-    // Output stream for writing JSON during serialization
-    ostream *os = nullptr;
+    // Output buffer for writing JSON during serialization
+    output_buffer *os = nullptr;
     // Configuration parameters and error information
     Parameters params;
+    // Number of objects and arrays being decoded
+    int depth = 0;
+    // Entry of the field mask for the message being decoded (see 'read_selected')
+    int mask_entry = 0;
+    // Objects and arrays being decoded, innermost last (see 'read_frames')
+    frame_stack frames;
+    // Whether the value at the current token is read by a frame, so nested objects and arrays
+    // are pushed to 'frames' instead of being decoded right away
+    bool nested = false;
 };
 
+// Accounts for an object or array being decoded until the end of the scope
+struct nesting_guard
+{
+    json_context &ctx;
+    nesting_guard( json_context &ctx ) : ctx(ctx) { ++ctx.depth; }
+    ~nesting_guard() { --ctx.depth; }
+};
+
+static inline bool too_deep( const json_context &ctx )
+{
+    return ctx.params.max_depth > 0 && ctx.depth >= ctx.params.max_depth;
+}
+
 static int set_error( ErrorInfo &error, error_code code, const std::string &msg )
 {
     if (error.code != error_code::PGERR_OK)
@@ -46,36 +125,569 @@ static int set_error( ErrorInfo &error, error_code code, const std::string &msg
 
 template<typename T, typename E = void> struct json;
 
-template<typename T, typename J = json<T> >
-static int read_object( json_context &ctx, T &object )
+template<typename T, typename _ = void>
+struct is_container : std::false_type {};
+
+template<typename... Ts>
+struct is_container_helper {};
+
+template<typename T>
+struct is_container<
+        T,
+        typename std::conditional<
+            false,
+            is_container_helper<
+                typename T::value_type,
+                typename T::size_type,
+                typename T::allocator_type,
+                typename T::iterator,
+                typename T::const_iterator,
+                decltype(std::declval<T>().size()),
+                decltype(std::declval<T>().begin()),
+                decltype(std::declval<T>().end()),
+                decltype(std::declval<T>().clear()),
+                decltype(std::declval<T>().empty())
+                >,
+            void
+            >::type
+        > : public std::true_type {};
+
+// Reads an object member (key, colon and value) and hands the value to 'read_field', which
+// returns PGR_NIL for unknown members. 'name' holds keys that are not referenced in the input and
+// 'hint' is the field expected to come next.
+template<typename F>
+static int read_member( json_context &ctx, std::string &name, int &hint, F &&read_field )
+{
+    auto &tt = ctx.tok->peek();
+    if (tt.id != token_id::STRING)
+        return ctx.tok->error(error_code::PGERR_INVALID_NAME, "object key must be string");
+    const char *key = tt.slice;
+    size_t size = tt.slice_size;
+    if (key == nullptr)
+    {
+        name.swap(tt.value);
+        key = name.data();
+        size = name.size();
+    }
+    ctx.tok->next();
+    if (!ctx.tok->expect(token_id::COLON))
+        return ctx.tok->error(error_code::PGERR_INVALID_SEPARATOR, "field name and value must be separated by ':'");
+    int result = read_field(key, size, hint);
+    if (result == PGR_ERROR) return result;
+    if (result == PGR_NIL)
+    {
+        result = ctx.tok->ignore();
+        if (result == PGR_ERROR) return result;
+    }
+    return PGR_OK;
+}
+
+// Decodes the object or array on top of the frame stack and everything nested in it. Readers of
+// the frames push nested objects and arrays to the stack (see 'push_frame'), which are decoded
+// before the next member or element of their parent, so the C++ stack does not grow with the
+// nesting level.
+static int read_frames( json_context &ctx )
+{
+    frame_stack &frames = ctx.frames;
+    size_t base = frames.size() - 1;
+    int depth = ctx.depth - 1;
+    const FieldMask *mask = ctx.params.mask;
+    int mask_entry = ctx.mask_entry;
+    std::string name;
+    int result = PGR_OK;
+    while (frames.size() > base)
+    {
+        // frames pushed by 'read' may move the stack, so no references are kept across it
+        size_t top = frames.size() - 1;
+        decode_frame &frame = frames[top];
+        bool first = frame.first;
+        frame.first = false;
+        if (first || !ctx.tok->expect(token_id::COMMA))
+        {
+            if (ctx.tok->expect(frame.array ? token_id::ARRE : token_id::OBJE))
+            {
+                frames.pop_back();
+                --ctx.depth;
+                if (frames.size() > base) frames[frames.size() - 1].pending = false;
+                continue;
+            }
+            if (!first)
+            {
+                if (frame.array)
+                    result = ctx.tok->error(error_code::PGERR_INVALID_ARRAY, "invalid array");
+                else
+                    result = ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid JSON object");
+                break;
+            }
+        }
+
+        auto read = frame.read;
+        void *object = frame.object;
+        int hint = frame.hint;
+        ctx.params.mask = frame.mask;
+        ctx.mask_entry = frame.mask_entry;
+        ctx.nested = true;
+        if (frame.array)
+            result = read(ctx, nullptr, 0, hint, object);
+        else
+            result = read_member(ctx, name, hint, [&ctx, read, object]( const char *key, size_t size, int &next )
+                { return read(ctx, key, size, next, object); });
+        ctx.nested = false;
+        if (result == PGR_ERROR) break;
+        frames[top].hint = hint;
+        frames[top].pending = (result == PGR_PUSH);
+        result = PGR_OK;
+    }
+    // elements still being decoded are removed, as if each level had failed in turn
+    for (size_t i = frames.size(); i > base; --i)
+    {
+        decode_frame &frame = frames[i - 1];
+        if (frame.pending && frame.drop != nullptr) frame.drop(frame.object);
+    }
+    frames.truncate(base);
+    ctx.depth = depth;
+    ctx.params.mask = mask;
+    ctx.mask_entry = mask_entry;
+    return result;
+}
+
+// Decodes the object or array whose opening bracket was just read. Values read by a frame are
+// pushed to the frame stack and decoded after the frame reader returns (PGR_PUSH), other values
+// are decoded right away.
+static int push_frame( json_context &ctx, int (*read)( json_context&, const char*, size_t, int&, void* ),
+    void *object, bool array, void (*drop)( void* ) = nullptr )
+{
+    decode_frame frame = { read, object, drop, ctx.params.mask, ctx.mask_entry, 0, array, true, false };
+    ctx.frames.push_back(frame);
+    ++ctx.depth;
+    if (!ctx.nested) return read_frames(ctx);
+    ctx.nested = false;
+    return PGR_PUSH;
+}
+
+template<typename T, typename J>
+static int read_object_field( json_context &ctx, const char *name, size_t size, int &hint, void *object )
+{
+    return J::read_field(ctx, name, size, hint, *static_cast<T*>(object));
+}
+
+template<typename J>
+static int validate_object_field( json_context &ctx, const char *name, size_t size, int &hint, void *object )
+{
+    (void) object;
+    return J::validate_field(ctx, name, size, hint);
+}
+
+// Checks the beginning of a JSON object, which is decoded by 'read_frames'
+static int open_object( json_context &ctx )
 {
     if (ctx.tok->peek().id == token_id::NIL) return PGR_NIL;
+    if (too_deep(ctx))
+        return ctx.tok->error(error_code::PGERR_TOO_DEEP, "too many nesting levels");
     if (!ctx.tok->expect(token_id::OBJS))
         return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "objects must start with '{'");
-    if (!ctx.tok->expect(token_id::OBJE))
+    return PGR_OK;
+}
+
+template<typename T, typename J = json<T> >
+static int read_object( json_context &ctx, T &object )
+{
+    int result = open_object(ctx);
+    if (result != PGR_OK) return result;
+    return push_frame(ctx, read_object_field<T, J>, &object, false);
+}
+
+// Checks a JSON object against the message schema without decoding it
+template<typename J>
+static int validate_object( json_context &ctx )
+{
+    int result = open_object(ctx);
+    if (result != PGR_OK) return result;
+    return push_frame(ctx, validate_object_field<J>, nullptr, false);
+}
+
+// Decodes a message field if it is selected by the field mask, or returns PGR_NIL to skip it. The
+// mask is matched against the JSON name of the field, as found in the input.
+template<typename T>
+static int read_selected( json_context &ctx, const char *name, size_t size, T &value )
+{
+    const FieldMask *mask = ctx.params.mask;
+    if (mask == nullptr) return json<T>::read(ctx, value);
+    int entry = mask->find(ctx.mask_entry, name, size);
+    if (entry < 0) return PGR_NIL;
+    int result;
+    if (mask->all(entry))
     {
-        while (true)
-        {
-            std::string name = ctx.tok->peek().value;
-            if (!ctx.tok->expect(token_id::STRING))
-                return ctx.tok->error(error_code::PGERR_INVALID_NAME, "object key must be string");
-            if (!ctx.tok->expect(token_id::COLON))
-                return ctx.tok->error(error_code::PGERR_INVALID_SEPARATOR, "field name and value must be separated by ':'");
-            int result = J::read_field(ctx, name, object);
-            if (result == PGR_ERROR) return result;
-            if (result != PGR_OK)
+        ctx.params.mask = nullptr;
+        result = json<T>::read(ctx, value);
+        ctx.params.mask = mask;
+    }
+    else
+    {
+        int parent = ctx.mask_entry;
+        ctx.mask_entry = entry;
+        result = json<T>::read(ctx, value);
+        ctx.mask_entry = parent;
+    }
+    return result;
+}
+
+// Deserializes a JSON value from the given input (see 'tokenizer' constructors)
+template<typename J, typename T, typename... I>
+static bool read_document( T &value, Parameters *params, I&&... input )
+{
+    json_context ctx;
+    if (params != nullptr) {
+        params->error.clear();
+        ctx.params = *params;
+    }
+    tokenizer tok(std::forward<I>(input)..., ctx.params);
+    ctx.tok = &tok;
+    int result = J::read(ctx, value);
+    if (result == PGR_OK) return true;
+    if (params != nullptr) params->error = std::move(ctx.params.error);
+    return false;
+}
+
+// Checks whether the given input (see 'tokenizer' constructors) is a valid JSON value for 'J'
+// without building the value
+template<typename J, typename... I>
+static bool validate_document( Parameters *params, I&&... input )
+{
+    json_context ctx;
+    if (params != nullptr) {
+        params->error.clear();
+        ctx.params = *params;
+    }
+    tokenizer tok(std::forward<I>(input)..., ctx.params);
+    ctx.tok = &tok;
+    int result = J::validate(ctx);
+    if (result == PGR_OK) return true;
+    if (result == PGR_NIL)
+        ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "objects must start with '{'");
+    if (params != nullptr) params->error = std::move(ctx.params.error);
+    return false;
+}
+
+// Creates a context with a copy of the parameters, if any, and no error
+static inline json_context make_context( const Parameters *params )
+{
+    json_context ctx;
+    if (params != nullptr) ctx.params = *params;
+    ctx.params.error.clear();
+    return ctx;
+}
+
+// Moves the tokenizer to the value at the given JSON pointer (e.g. "/people/0/name"), skipping
+// members and elements outside the path. Array indices with leading zeros are not valid.
+static int find_pointer( json_context &ctx, const std::string &pointer )
+{
+    std::string segment;
+    size_t pos = 0;
+    while (pos < pointer.size())
+    {
+        if (pointer[pos] != '/')
+            return set_error(ctx.params.error, error_code::PGERR_INVALID_VALUE, "invalid JSON pointer");
+        size_t end = pointer.find('/', pos + 1);
+        if (end == std::string::npos) end = pointer.size();
+        segment.clear();
+        for (size_t i = pos + 1; i < end; ++i)
+        {
+            // escaped characters
+            if (pointer[i] == '~' && i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1'))
+                segment += (pointer[++i] == '0') ? '~' : '/';
+            else
+                segment += pointer[i];
+        }
+        bool found = false;
+        if (ctx.tok->expect(token_id::OBJS))
+        {
+            bool last = ctx.tok->expect(token_id::OBJE);
+            while (!found && !last)
             {
-                result = ctx.tok->ignore();
-                if (result == PGR_ERROR) return result;
+                auto &tt = ctx.tok->peek();
+                if (tt.id != token_id::STRING)
+                    return ctx.tok->error(error_code::PGERR_INVALID_NAME, "object key must be string");
+                if (tt.slice != nullptr)
+                    found = tt.slice_size == segment.size() && memcmp(tt.slice, segment.data(), segment.size()) == 0;
+                else
+                    found = tt.value == segment;
+                ctx.tok->next();
+                if (!ctx.tok->expect(token_id::COLON))
+                    return ctx.tok->error(error_code::PGERR_INVALID_SEPARATOR, "field name and value must be separated by ':'");
+                if (found) break;
+                if (ctx.tok->ignore() == PGR_ERROR) return PGR_ERROR;
+                if (ctx.tok->expect(token_id::COMMA)) continue;
+                if (ctx.tok->expect(token_id::OBJE))
+                    last = true;
+                else
+                    return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid JSON object");
             }
-            if (ctx.tok->expect(token_id::COMMA)) continue;
-            if (ctx.tok->expect(token_id::OBJE)) break;
-            return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid JSON object");
-        };
+        }
+        else
+        if (ctx.tok->expect(token_id::ARRS) && !segment.empty() && segment.size() < 10 &&
+            segment.find_first_not_of("0123456789") == std::string::npos &&
+            (segment[0] != '0' || segment.size() == 1))
+        {
+            size_t index = (size_t) std::stoul(segment);
+            bool last = ctx.tok->expect(token_id::ARRE);
+            for (size_t i = 0; i < index && !last; ++i)
+            {
+                if (ctx.tok->ignore() == PGR_ERROR) return PGR_ERROR;
+                if (ctx.tok->expect(token_id::COMMA)) continue;
+                if (ctx.tok->expect(token_id::ARRE))
+                    last = true;
+                else
+                    return ctx.tok->error(error_code::PGERR_INVALID_ARRAY, "invalid array");
+            }
+            found = !last;
+        }
+        if (!found)
+            return set_error(ctx.params.error, error_code::PGERR_MISSING_FIELD, "no value at '" + pointer.substr(0, end) + "'");
+        pos = end;
     }
     return PGR_OK;
 }
 
+// Decodes only the value at the given JSON pointer (see 'find_pointer'). The parser stops after
+// the value, so the rest of the input is not read. A null value is reported as a missing value
+// and 'value' is left unchanged.
+template<typename T>
+static bool extract( const std::string &pointer, T &value, const char *data, size_t size,
+    Parameters *params = nullptr )
+{
+    json_context ctx = make_context(params);
+    tokenizer tok(data, data + size, ctx.params);
+    ctx.tok = &tok;
+    int result = find_pointer(ctx, pointer);
+    if (result == PGR_OK)
+    {
+        result = json<T>::read(ctx, value);
+        if (result == PGR_NIL)
+            result = set_error(ctx.params.error, error_code::PGERR_MISSING_FIELD, "null value at '" + pointer + "'");
+    }
+    if (params != nullptr) params->error = std::move(ctx.params.error);
+    return result == PGR_OK;
+}
+
+template<typename T>
+static bool extract( const std::string &pointer, T &value, const std::string &data, Parameters *params = nullptr )
+{
+    return extract(pointer, value, data.data(), data.size(), params);
+}
+
+// Reusable deserialization context for contiguous inputs. The tokenizer and its buffers are kept
+// between calls, so decoding many documents in the same thread requires no setup allocations.
+class Decoder
+{
+    public:
+        Decoder( const Parameters *params = nullptr ) : ctx_(make_context(params)),
+            tok_(nullptr, nullptr, ctx_.params)
+        {
+            ctx_.tok = &tok_;
+        }
+        Decoder( const Decoder& ) = delete;
+        Decoder &operator=( const Decoder& ) = delete;
+
+        // Decodes a message or container (see 'deserialize')
+        template<typename T>
+        bool decode( T &value, const char *in, size_t len )
+        {
+            ctx_.params.error.clear();
+            tok_.reset(in, in + len);
+            return json<T>::read(ctx_, value) == PGR_OK;
+        }
+        template<typename T>
+        bool decode( T &value, const std::string &in ) { return decode(value, in.data(), in.size()); }
+
+        // Information about the error in the last call
+        const ErrorInfo &error() const { return ctx_.params.error; }
+
+    protected:
+        json_context ctx_;
+        tokenizer tok_;
+};
+
+// Reusable serialization context. The JSON is written to an internal buffer that keeps its memory
+// between calls.
+class Encoder
+{
+    public:
+        Encoder( const Parameters *params = nullptr ) : ctx_(make_context(params)) {}
+        Encoder( const Encoder& ) = delete;
+        Encoder &operator=( const Encoder& ) = delete;
+
+        // Encodes a message or container into the internal buffer (see 'output')
+        template<typename T>
+        bool encode( const T &value )
+        {
+            buffer_.clear();
+            ctx_.params.error.clear();
+            int result;
+            {
+                output_buffer os(buffer_);
+                ctx_.os = &os;
+                result = json<T>::write(ctx_, value);
+            }
+            ctx_.os = nullptr;
+            return result == PGR_OK;
+        }
+        // Encodes a message or container and copies the JSON to the given output
+        template<typename T>
+        bool encode( const T &value, ostream &out )
+        {
+            bool result = encode(value);
+            out << buffer_;
+            return result;
+        }
+
+        // JSON produced by the last call to 'encode'
+        const std::string &output() const { return buffer_; }
+        // Information about the error in the last call
+        const ErrorInfo &error() const { return ctx_.params.error; }
+
+    protected:
+        json_context ctx_;
+        std::string buffer_;
+};
+
+// Message field decoded on first access. During deserialization the field only keeps the JSON
+// text of the message, which is skipped without being parsed. Accessors decode the text with the
+// options of the deserialization that captured it (use 'decode' to get error information).
+//
+// If 'PROTOGEN_X_Y_Z__THREADS' is defined, const member functions, except 'text', can be called
+// from several threads at once: the text is decoded once, under a lock, by the first of them.
+// Otherwise fields have no lock and need exclusive access, as non-const member functions always
+// do. The macro must be defined the same way in every translation unit.
+template<typename T>
+class lazy_field
+{
+    protected:
+        mutable T value_;
+        // JSON text not decoded yet
+        mutable std::string text_;
+        // Options of the deserialization that captured the text, with the nesting levels left
+        mutable Parameters params_;
+        #if defined(PROTOGEN_X_Y_Z__THREADS)
+        mutable std::atomic<bool> pending_;
+        // Held while the text is decoded
+        mutable std::mutex mutex_;
+        #else
+        mutable bool pending_;
+        #endif
+    public:
+        typedef T value_type;
+        lazy_field() : pending_(false) {}
+        lazy_field( const lazy_field &that ) : pending_(false) { *this = that; }
+        lazy_field( lazy_field &&that ) noexcept : value_(std::move(that.value_)),
+            text_(std::move(that.text_)), params_(std::move(that.params_)), pending_((bool) that.pending_)
+        {
+            that.pending_ = false;
+        }
+        lazy_field( const value_type &that ) : value_(that), pending_(false) {}
+        lazy_field &operator=( const lazy_field &that )
+        {
+            if (this == &that) return *this;
+            #if defined(PROTOGEN_X_Y_Z__THREADS)
+            std::lock_guard<std::mutex> lock(that.mutex_);
+            #endif
+            value_ = that.value_;
+            text_ = that.text_;
+            params_ = that.params_;
+            pending_ = (bool) that.pending_;
+            return *this;
+        }
+        lazy_field &operator=( const value_type &that ) { value_ = that; text_.clear(); pending_ = false; return *this; }
+
+        // Decodes the pending JSON text, if any, with the options of the deserialization that
+        // captured it. If the text is invalid, returns false, the value is left empty and the
+        // error is stored in 'params', if given.
+        bool decode( Parameters *params = nullptr ) const
+        {
+            #if defined(PROTOGEN_X_Y_Z__THREADS)
+            if (!pending_.load(std::memory_order_acquire)) return true;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!pending_.load(std::memory_order_relaxed)) return true;
+            #else
+            if (!pending_) return true;
+            #endif
+            bool result = read_document< json<T>, T >(value_, &params_, text_.data(), text_.data() + text_.size());
+            if (!result) json<T>::clear(value_);
+            if (params != nullptr) params->error = std::move(params_.error);
+            std::string().swap(text_);
+            #if defined(PROTOGEN_X_Y_Z__THREADS)
+            pending_.store(false, std::memory_order_release);
+            #else
+            pending_ = false;
+            #endif
+            return result;
+        }
+        // Replaces the value with the text of the object at the current token. Nested objects and
+        // arrays count towards the nesting levels left in 'ctx'.
+        bool capture( json_context &ctx )
+        {
+            json<T>::clear(value_);
+            text_.clear();
+            params_ = ctx.params;
+            params_.mask = nullptr;
+            params_.error.clear();
+            params_.max_depth = ctx.params.max_depth > 0 ? ctx.params.max_depth - ctx.depth : 0;
+            pending_ = ctx.tok->capture(text_);
+            return pending_;
+        }
+        bool pending() const { return pending_; }
+        const std::string &text() const { return text_; }
+        void swap( lazy_field &that )
+        {
+            std::swap(value_, that.value_);
+            text_.swap(that.text_);
+            std::swap(params_, that.params_);
+            bool pending = pending_;
+            pending_ = (bool) that.pending_;
+            that.pending_ = pending;
+        }
+        void clear() { json<T>::clear(value_); text_.clear(); pending_ = false; }
+        value_type &get() { decode(); return value_; }
+        const value_type &get() const { decode(); return value_; }
+        value_type &operator *() { return get(); }
+        const value_type &operator *() const { return get(); }
+        value_type *operator ->() { return &get(); }
+        const value_type *operator ->() const { return &get(); }
+        bool operator==( const lazy_field &that ) const { return json<T>::equal(get(), that.get()); }
+        bool operator!=( const lazy_field &that ) const { return !json<T>::equal(get(), that.get()); }
+};
+
+template<typename T>
+struct json< lazy_field<T> >
+{
+    static int read( json_context &ctx, lazy_field<T> &value )
+    {
+        auto &tt = ctx.tok->peek();
+        if (tt.id == token_id::NIL) return PGR_NIL;
+        if (tt.id != token_id::OBJS)
+            return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "objects must start with '{'");
+        // the field mask is not kept after the deserialization, so selected fields are decoded
+        // right away
+        if (ctx.params.mask != nullptr)
+        {
+            value.clear();
+            return json<T>::read(ctx, *value);
+        }
+        if (too_deep(ctx))
+            return ctx.tok->error(error_code::PGERR_TOO_DEEP, "too many nesting levels");
+        if (!value.capture(ctx))
+            return ctx.tok->error(error_code::PGERR_INVALID_OBJECT, "invalid JSON object");
+        return PGR_OK;
+    }
+    // Validates the whole value, as it would be decoded on first access
+    static int validate( json_context &ctx ) { return json<T>::validate(ctx); }
+    static int write( json_context &ctx, const lazy_field<T> &value ) { return json<T>::write(ctx, *value); }
+    static bool empty( const lazy_field<T> &value ) { return json<T>::empty(*value); }
+    static void clear( lazy_field<T> &value ) { value.clear(); }
+    static bool equal( const lazy_field<T> &a, const lazy_field<T> &b ) { return a == b; }
+    static void swap( lazy_field<T> &a, lazy_field<T> &b ) { a.swap(b); }
+};
+
 #define PG_X_Y_Z_ENTITY(N,O,S) \
     struct N : public O, public protogen_X_Y_Z::message< O, S > \
     { \
@@ -89,19 +701,21 @@ static int read_object( json_context &ctx, T &object )
         using protogen_X_Y_Z::message<O, S>::deserialize; \
         bool deserialize( protogen_X_Y_Z::istream& in, protogen_X_Y_Z::Parameters *params = nullptr ) override \
         { \
-            protogen_X_Y_Z::json_context ctx; \
-            if (params != nullptr) { \
-                params->error.clear(); \
-                ctx.params = *params; \
-            } \
-            protogen_X_Y_Z::tokenizer tok(in, ctx.params); \
-            ctx.tok = &tok; \
-            int result = S::read(ctx, *this); \
-            if (result == protogen_X_Y_Z::PGR_OK) return true; \
-            if (params != nullptr) params->error = std::move(ctx.params.error); \
-            return false; \
+            return protogen_X_Y_Z::read_document<S, O>(*this, params, in); \
+        } \
+        bool deserialize( const char *in, size_t len, protogen_X_Y_Z::Parameters *params = nullptr ) override \
+        { \
+            return protogen_X_Y_Z::read_document<S, O>(*this, params, in, in + len); \
+        } \
+        static bool validate( const char *in, size_t len, protogen_X_Y_Z::Parameters *params = nullptr ) \
+        { \
+            return protogen_X_Y_Z::validate_document<S>(params, in, in + len); \
+        } \
+        static bool validate( const std::string &in, protogen_X_Y_Z::Parameters *params = nullptr ) \
+        { \
+            return validate(in.data(), in.size(), params); \
         } \
-        bool serialize( protogen_X_Y_Z::ostream &out, protogen_X_Y_Z::Parameters *params = nullptr ) const override \
+        bool serialize( protogen_X_Y_Z::output_buffer &out, protogen_X_Y_Z::Parameters *params = nullptr ) const override \
         { \
             protogen_X_Y_Z::json_context ctx; \
             ctx.os = &out; \
@@ -126,7 +740,9 @@ static int read_object( json_context &ctx, T &object )
     struct json<N> \
     { \
         static int read( json_context &ctx, O &value ) { return S::read(ctx, value); } \
-        static int read_field( json_context &ctx, const std::string &name, O &value ) { return S::read_field(ctx, name, value); } \
+        static int read_field( json_context &ctx, const char *name, size_t size, int &hint, O &value ) { return S::read_field(ctx, name, size, hint, value); } \
+        static int validate( json_context &ctx ) { return S::validate(ctx); } \
+        static int validate_field( json_context &ctx, const char *name, size_t size, int &hint ) { return S::validate_field(ctx, name, size, hint); } \
         static int write( json_context &ctx, const O &value ) { return S::write(ctx, value); } \
         static bool empty( const O &value ) { return S::empty(value); } \
         static void clear( O &value ) { S::clear(value); } \
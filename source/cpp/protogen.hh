@@ -29,6 +29,35 @@
 #include <memory>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <cstdio>
+#include <cerrno>
+#include <clocale>
+
+// Lazy fields can be decoded from several threads (see 'lazy_field')
+#if defined(PROTOGEN_X_Y_Z__THREADS)
+#include <mutex>
+#include <atomic>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PROTOGEN_X_Y_Z__AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROTOGEN_X_Y_Z__SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PROTOGEN_X_Y_Z__POSIX
+#endif
 
 namespace protogen_X_Y_Z {
 
@@ -42,6 +71,8 @@ enum error_code
     PGERR_INVALID_OBJECT    = 5,
     PGERR_INVALID_NAME      = 6,
     PGERR_INVALID_ARRAY     = 7,
+    PGERR_INVALID_FILE      = 8,
+    PGERR_TOO_DEEP          = 9,
 };
 
 enum parse_error
@@ -49,6 +80,8 @@ enum parse_error
     PGR_OK,
     PGR_ERROR,
     PGR_NIL,
+    // The object or array was pushed to the frame stack and is decoded later (see 'read_frames')
+    PGR_PUSH,
 };
 
 struct ErrorInfo
@@ -85,6 +118,68 @@ struct ErrorInfo
     }
 };
 
+// Subset of fields to decode, given as dotted paths of JSON field names (e.g. "owner.name"), the
+// same names used by 'extract'. Fields with the 'name' option are selected by that name and, with
+// 'number_names', fields are selected by number. Paths inside repeated messages apply to every
+// element.
+class FieldMask
+{
+    public:
+        FieldMask() : entries_(1) {}
+        FieldMask( std::initializer_list<std::string> paths ) : entries_(1)
+        {
+            for (const auto &path : paths) add(path);
+        }
+
+        // Selects the field (and everything inside it) at the given path
+        FieldMask &add( const std::string &path )
+        {
+            int entry = 0;
+            size_t start = 0;
+            while (start <= path.size() && !entries_[(size_t) entry].all)
+            {
+                size_t end = path.find('.', start);
+                if (end == std::string::npos) end = path.size();
+                int next = find(entry, path.data() + start, end - start);
+                if (next < 0)
+                {
+                    entries_.push_back(entry_t{path.substr(start, end - start), entry, false});
+                    next = (int) entries_.size() - 1;
+                }
+                entry = next;
+                start = end + 1;
+            }
+            entries_[(size_t) entry].all = true;
+            return *this;
+        }
+
+        // Returns the entry of a field inside the given entry (zero for the root), or -1 if the
+        // field is not selected
+        int find( int parent, const char *name, size_t size ) const
+        {
+            for (size_t i = (size_t) parent + 1; i < entries_.size(); ++i)
+            {
+                const auto &entry = entries_[i];
+                if (entry.parent == parent && entry.name.size() == size &&
+                    memcmp(entry.name.data(), name, size) == 0)
+                    return (int) i;
+            }
+            return -1;
+        }
+
+        // Returns whether everything inside the given entry is selected
+        bool all( int entry ) const { return entries_[(size_t) entry].all; }
+
+    private:
+        struct entry_t
+        {
+            std::string name;
+            int parent;
+            bool all;
+        };
+        std::vector<entry_t> entries_;
+};
+
 struct Parameters
 {
     /// If true, ensures the output JSON will have all non-ASCII characters escaped.
@@ -93,10 +188,84 @@ struct Parameters
 
     bool serialize_null = false;
 
+    /// If true, contiguous inputs are indexed in a first pass that records the position of every
+    /// token outside strings. The parser then jumps between tokens and skips unknown objects
+    /// and arrays in constant time, without validating their contents. Default is false.
+    bool structural_index = false;
+
+    /// If true, only the position in contiguous inputs is tracked while parsing and the line and
+    /// column of errors are computed by scanning the input again. Generic inputs always track
+    /// lines and columns. Default is false.
+    bool lazy_position = false;
+
+    /// Maximum number of nested objects and arrays decoded into messages and containers. Deeper
+    /// inputs fail with 'PGERR_TOO_DEEP'. Objects and arrays are decoded with a frame stack in the
+    /// decoding context instead of recursive calls, so the C++ stack does not grow with the
+    /// nesting level; the first 16 levels need no memory allocation. Unknown values are skipped
+    /// without recursion and are not limited. Zero disables the limit. Default is 256.
+    int max_depth = 256;
+
+    /// If not null, only the selected fields are decoded and the others are skipped like unknown
+    /// fields. The object must outlive the operation. Default is null (every field).
+    const FieldMask *mask = nullptr;
+
     /// Information about the error that occurred during the last operation.
     ErrorInfo error;
 };
 
+// Digit pairs from "00" to "99"
+static const char INTEGER_DIGITS[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+template<typename T, typename std::enable_if<std::is_signed<T>::value, int>::type = 0>
+static inline typename std::make_unsigned<T>::type integer_magnitude( T value, bool &negative )
+{
+    typedef typename std::make_unsigned<T>::type U;
+    negative = value < 0;
+    // two's complement negation also works for the minimum value
+    return negative ? (U) ((U) 0 - (U) value) : (U) value;
+}
+
+template<typename T, typename std::enable_if<!std::is_signed<T>::value, int>::type = 0>
+static inline T integer_magnitude( T value, bool &negative )
+{
+    negative = false;
+    return value;
+}
+
+// Maximum number of characters of a formatted integer (sign and 20 digits)
+static const size_t MAX_INTEGER_SIZE = 21;
+
+// Formats an integer two digits at a time, writing backwards from 'end'. Returns a pointer to the
+// first character. The buffer must have at least 'MAX_INTEGER_SIZE' characters before 'end'.
+template<typename T>
+static inline char *format_integer( T value, char *end )
+{
+    bool negative;
+    auto number = integer_magnitude(value, negative);
+    while (number >= 100)
+    {
+        const char *pair = INTEGER_DIGITS + (size_t) (number % 100) * 2;
+        number /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if (number >= 10)
+    {
+        const char *pair = INTEGER_DIGITS + (size_t) number * 2;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    else
+        *--end = (char) ('0' + number);
+    if (negative) *--end = '-';
+    return end;
+}
+
 class ostream
 {
     public:
@@ -106,7 +275,15 @@ class ostream
         virtual ostream &operator<<( const char *value ) = 0;
         virtual ostream &operator<<( char *value ) = 0;
         virtual ostream &operator<<( char value ) = 0;
-        template<class T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+        template<class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        ostream &operator<<( T value )
+        {
+            char buffer[MAX_INTEGER_SIZE + 1];
+            buffer[MAX_INTEGER_SIZE] = 0;
+            this->operator<<( (const char*) format_integer(value, buffer + MAX_INTEGER_SIZE) );
+            return *this;
+        }
+        template<class T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
         ostream &operator<<( T value )
         {
             this->operator<<( std::to_string(value) );
@@ -143,6 +320,180 @@ class iterator_ostream : public ostream
         I beg_;
 };
 
+// Contiguous sink used by the serializer. The JSON is copied in bulk into the target without
+// virtual calls: strings and vectors are written in place, memory is written up to its size and
+// streams receive the JSON in chunks. The contents of the target are complete after 'flush' or
+// the destruction of the buffer.
+class output_buffer
+{
+    public:
+        // Appends to the string
+        output_buffer( std::string &out ) : kind_(TARGET_STRING), string_(&out)
+        {
+            cur_ = end_ = data(out) + out.size();
+        }
+        // Appends to the vector
+        output_buffer( std::vector<char> &out ) : kind_(TARGET_VECTOR), vector_(&out)
+        {
+            cur_ = end_ = out.data() + out.size();
+        }
+        // Writes at most 'size' characters, without null terminator
+        output_buffer( char *out, size_t size ) : kind_(TARGET_MEMORY), cur_(out), end_(out + size) {}
+        // Writes to the stream in chunks of 'BUFFER_SIZE' characters
+        output_buffer( std::ostream &out ) : kind_(TARGET_STREAM), stream_(&out)
+        {
+            chunk_.resize(BUFFER_SIZE);
+            cur_ = data(chunk_);
+            end_ = cur_ + chunk_.size();
+        }
+        output_buffer( ostream &out ) : kind_(TARGET_OSTREAM), ostream_(&out)
+        {
+            chunk_.resize(BUFFER_SIZE);
+            cur_ = data(chunk_);
+            end_ = cur_ + chunk_.size();
+        }
+        output_buffer( const output_buffer& ) = delete;
+        output_buffer &operator=( const output_buffer& ) = delete;
+        ~output_buffer() { flush(); }
+
+        output_buffer &append( const char *data, size_t size )
+        {
+            if (size <= (size_t) (end_ - cur_))
+            {
+                memcpy(cur_, data, size);
+                cur_ += size;
+            }
+            else
+                overflow(data, size);
+            return *this;
+        }
+        output_buffer &operator<<( char value )
+        {
+            if (cur_ < end_)
+                *cur_++ = value;
+            else
+                overflow(&value, 1);
+            return *this;
+        }
+        output_buffer &operator<<( const char *value ) { return append(value, strlen(value)); }
+        output_buffer &operator<<( const std::string &value ) { return append(value.data(), value.size()); }
+        // Formats the integer in place, without temporary strings
+        template<class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        output_buffer &operator<<( T value )
+        {
+            char buffer[MAX_INTEGER_SIZE];
+            char *end = buffer + MAX_INTEGER_SIZE;
+            char *begin = format_integer(value, end);
+            return append(begin, (size_t) (end - begin));
+        }
+        template<class T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+        output_buffer &operator<<( T value )
+        {
+            return *this << std::to_string(value);
+        }
+
+        // Trims strings and vectors to the characters written and writes the pending chunk to
+        // streams
+        void flush()
+        {
+            switch (kind_)
+            {
+                case TARGET_STRING:
+                    string_->resize((size_t) (cur_ - data(*string_)));
+                    cur_ = end_ = data(*string_) + string_->size();
+                    break;
+                case TARGET_VECTOR:
+                    vector_->resize((size_t) (cur_ - vector_->data()));
+                    cur_ = end_ = vector_->data() + vector_->size();
+                    break;
+                case TARGET_STREAM:
+                case TARGET_OSTREAM:
+                    if (cur_ == data(chunk_)) break;
+                    chunk_.resize((size_t) (cur_ - data(chunk_)));
+                    if (kind_ == TARGET_STREAM)
+                        stream_->write(chunk_.data(), (std::streamsize) chunk_.size());
+                    else
+                        *ostream_ << chunk_;
+                    chunk_.resize(BUFFER_SIZE);
+                    cur_ = data(chunk_);
+                    end_ = cur_ + chunk_.size();
+                    break;
+                default:
+                    break;
+            }
+        }
+
+    protected:
+        static const size_t BUFFER_SIZE = 4096;
+        // Minimum growth of strings and vectors
+        static const size_t MIN_GROWTH = 256;
+
+        enum target_kind
+        {
+            TARGET_STRING,
+            TARGET_VECTOR,
+            TARGET_MEMORY,
+            TARGET_STREAM,
+            TARGET_OSTREAM,
+        };
+
+        target_kind kind_;
+        // Free space in the target (or in 'chunk_' for streams)
+        char *cur_, *end_;
+        union
+        {
+            std::string *string_;
+            std::vector<char> *vector_;
+            std::ostream *stream_;
+            ostream *ostream_;
+        };
+        // Characters not yet written to streams
+        std::string chunk_;
+
+        static char *data( std::string &value ) { return &value[0]; }
+
+        template<typename C>
+        void grow( C &target, size_t size )
+        {
+            size_t used = (size_t) (cur_ - target.data());
+            // the size grows geometrically, so the appends are amortized
+            target.resize(used + std::max(size, std::max(used, (size_t) MIN_GROWTH)));
+            cur_ = &target[0] + used;
+            end_ = &target[0] + target.size();
+        }
+
+        void overflow( const char *data, size_t size )
+        {
+            switch (kind_)
+            {
+                case TARGET_STRING:
+                    grow(*string_, size);
+                    break;
+                case TARGET_VECTOR:
+                    grow(*vector_, size);
+                    break;
+                case TARGET_MEMORY:
+                    // the remaining characters are dropped
+                    size = (size_t) (end_ - cur_);
+                    break;
+                case TARGET_STREAM:
+                case TARGET_OSTREAM:
+                    while (size > (size_t) (end_ - cur_))
+                    {
+                        size_t count = (size_t) (end_ - cur_);
+                        memcpy(cur_, data, count);
+                        cur_ += count;
+                        data += count;
+                        size -= count;
+                        flush();
+                    }
+                    break;
+            }
+            memcpy(cur_, data, size);
+            cur_ += size;
+        }
+};
+
 struct istream
 {
     istream() = default;
@@ -152,8 +503,194 @@ struct istream
     virtual bool eof() const = 0;
     virtual int line() const = 0;
     virtual int column() const = 0;
+
+    // Reads up to 'size' characters into 'data'. Returns zero at the end of the input. The default
+    // implementation copies the characters given by 'peek' one at a time.
+    virtual size_t read( char *data, size_t size )
+    {
+        size_t count = 0;
+        for (; count < size && !eof(); next())
+            data[count++] = (char) peek();
+        return count;
+    }
 };
 
+// Base class for inputs read in blocks, which are handed to the parser without going through the
+// character interface
+class block_istream : public istream
+{
+    public:
+        block_istream() : offset_(0), line_(1), column_(1) {}
+        int peek() override
+        {
+            if (!load()) return 0;
+            return (unsigned char) chars_[offset_];
+        }
+        void next() override
+        {
+            if (!load()) return;
+            if (chars_[offset_++] == '\n')
+            {
+                ++line_;
+                column_ = 1;
+            }
+            else
+                ++column_;
+        }
+        bool eof() const override { return !load(); }
+        int line() const override { return line_; }
+        int column() const override { return column_; }
+        size_t read( char *data, size_t size ) override
+        {
+            // characters already loaded by 'peek'
+            if (offset_ < chars_.size())
+            {
+                size_t count = std::min(size, chars_.size() - offset_);
+                memcpy(data, chars_.data() + offset_, count);
+                offset_ += count;
+                return count;
+            }
+            return read_block(data, size);
+        }
+
+    protected:
+        // Reads the next block from the source. Returns zero at the end of the input.
+        virtual size_t read_block( char *data, size_t size ) = 0;
+
+    private:
+        // Characters loaded for the character interface
+        mutable std::string chars_;
+        mutable size_t offset_;
+        int line_, column_;
+
+        bool load() const
+        {
+            if (offset_ < chars_.size()) return true;
+            chars_.resize(256);
+            offset_ = 0;
+            chars_.resize(const_cast<block_istream*>(this)->read_block(&chars_[0], chars_.size()));
+            return !chars_.empty();
+        }
+};
+
+// Input from a stream buffer (e.g. 'std::cin.rdbuf()')
+class streambuf_istream : public block_istream
+{
+    public:
+        streambuf_istream( std::streambuf &input ) : input_(input) {}
+    protected:
+        std::streambuf &input_;
+        size_t read_block( char *data, size_t size ) override
+        {
+            std::streamsize count = input_.sgetn(data, (std::streamsize) size);
+            return (count > 0) ? (size_t) count : 0;
+        }
+};
+
+// Input from a stream buffer that ends after the top-level object or array. Characters after the
+// document are left in the stream buffer, so the next document can be read from it.
+class document_istream : public block_istream
+{
+    public:
+        document_istream( std::streambuf &input ) : input_(input), depth_(0), in_string_(false),
+            escape_(false), done_(false), eof_(false) {}
+        // Whether the end of the stream buffer was reached
+        bool reached_eof() const { return eof_; }
+    protected:
+        std::streambuf &input_;
+        size_t depth_;
+        bool in_string_, escape_, done_, eof_;
+
+        size_t read_block( char *data, size_t size ) override
+        {
+            if (done_ || eof_) return 0;
+            // only characters already buffered are taken, so the excess can be put back
+            std::streamsize count = std::min(input_.in_avail(), (std::streamsize) size);
+            if (count > 0)
+                count = input_.sgetn(data, count);
+            else
+            {
+                int c = input_.sbumpc();
+                if (c == std::char_traits<char>::eof())
+                {
+                    eof_ = true;
+                    return 0;
+                }
+                data[0] = (char) c;
+                count = 1;
+            }
+            size_t end = scan(data, (size_t) count);
+            for (size_t i = end; i < (size_t) count; ++i) input_.sungetc();
+            return end;
+        }
+
+        // Returns the number of characters up to the end of the document
+        size_t scan( const char *data, size_t size )
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                char c = data[i];
+                if (escape_)
+                    escape_ = false;
+                else
+                if (in_string_)
+                {
+                    if (c == '\\')
+                        escape_ = true;
+                    else
+                    if (c == '"')
+                        in_string_ = false;
+                }
+                else
+                if (c == '"')
+                    in_string_ = true;
+                else
+                if (c == '{' || c == '[')
+                    ++depth_;
+                else
+                if ((c == '}' || c == ']') && (depth_ == 0 || --depth_ == 0))
+                {
+                    done_ = true;
+                    return i + 1;
+                }
+            }
+            return size;
+        }
+};
+
+// Input from a C stream
+class file_istream : public block_istream
+{
+    public:
+        file_istream( FILE *input ) : input_(input) {}
+    protected:
+        FILE *input_;
+        size_t read_block( char *data, size_t size ) override
+        {
+            return fread(data, 1, size, input_);
+        }
+};
+
+#ifdef PROTOGEN_X_Y_Z__POSIX
+// Input from a file descriptor (e.g. pipes and sockets)
+class fd_istream : public block_istream
+{
+    public:
+        fd_istream( int input ) : input_(input) {}
+    protected:
+        int input_;
+        size_t read_block( char *data, size_t size ) override
+        {
+            while (true)
+            {
+                ssize_t count = ::read(input_, data, size);
+                if (count >= 0) return (size_t) count;
+                if (errno != EINTR) return 0;
+            }
+        }
+};
+#endif
+
 template<typename I>
 class iterator_istream : public istream
 {
@@ -161,27 +698,47 @@ class iterator_istream : public istream
         iterator_istream( const I& first, const I& last ) : beg_(first), end_(last), line_(1),
             column_(1)
         {
-            skip();
         }
         int peek() override
         {
+            skip();
             if (beg_ == end_) return 0;
             return *beg_;
         }
         void next() override
         {
+            skip();
             if (beg_ == end_) return;
             ++beg_;
             ++column_;
-            skip();
         }
-        bool eof() const override { return beg_ == end_; }
-        int line() const override { return line_; }
-        int column() const override { return column_; }
+        bool eof() const override { skip(); return beg_ == end_; }
+        int line() const override { skip(); return line_; }
+        int column() const override { skip(); return column_; }
+        // Unlike the character interface, line breaks are copied as well
+        size_t read( char *data, size_t size ) override
+        {
+            size_t count = 0;
+            for (; count < size && !(beg_ == end_); ++beg_)
+            {
+                char c = (char) *beg_;
+                data[count++] = c;
+                if (c == '\n')
+                {
+                    ++line_;
+                    column_ = 1;
+                }
+                else
+                    ++column_;
+            }
+            return count;
+        }
     protected:
-        I beg_, end_;
-        int line_, column_;
-        void skip()
+        // Line breaks are skipped on demand, so 'read' still finds them
+        mutable I beg_;
+        I end_;
+        mutable int line_, column_;
+        void skip() const
         {
             while (!(beg_ == end_) && *beg_ == '\n')
             {
@@ -263,18 +820,24 @@ struct token
     token_id id;
     std::string value;
     int line, column;
+    // Text of string tokens without escape sequences, referenced directly in contiguous inputs.
+    // If null, the text is stored in 'value'.
+    const char *slice;
+    size_t slice_size;
 
-    token() : id(token_id::NONE), line(0), column(0) {}
+    token() : id(token_id::NONE), line(0), column(0), slice(nullptr), slice_size(0) {}
     token( const token &that ) { *this = that; }
-    token( token &&that ) { swap(that); }
+    token( token &&that ) : token() { swap(that); }
     token( token_id id, const std::string &value = "", int line = 0, int col = 0 ) : id(id), value(value),
-        line(line), column(col) {}
+        line(line), column(col), slice(nullptr), slice_size(0) {}
     token &operator=( const token &that )
     {
         id = that.id;
         value = that.value;
         line = that.line;
         column = that.column;
+        slice = that.slice;
+        slice_size = that.slice_size;
         return *this;
     }
     void swap( token &that )
@@ -283,37 +846,383 @@ struct token
         value.swap(that.value);
         std::swap(line, that.line);
         std::swap(column, that.column);
+        std::swap(slice, that.slice);
+        std::swap(slice_size, that.slice_size);
+    }
+    const char *data() const { return (slice != nullptr) ? slice : value.data(); }
+    size_t size() const { return (slice != nullptr) ? slice_size : value.size(); }
+    // Moves the text to 'out'. Slices are copied and decoded strings are moved.
+    void take( std::string &out )
+    {
+        if (slice != nullptr)
+            out.assign(slice, slice_size);
+        else
+            out.swap(value);
     }
 };
 
+static inline int count_trailing_zeros( uint32_t value )
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (int) index;
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+static inline int count_trailing_zeros( uint64_t value )
+{
+#if defined(_MSC_VER)
+    uint32_t low = (uint32_t) value;
+    if (low != 0) return count_trailing_zeros(low);
+    return 32 + count_trailing_zeros((uint32_t) (value >> 32));
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// Returns the first quote, backslash or control character in [begin, end)
+static inline const char *scan_string( const char *begin, const char *end )
+{
+#if defined(PROTOGEN_X_Y_Z__AVX2)
+    if (end - begin >= 32)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i control = _mm256_set1_epi8(0x1F);
+        while (end - begin >= 32)
+        {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*) begin);
+            // 'max(c, 0x1F) == 0x1F' is an unsigned 'c < 0x20'
+            __m256i mask = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+                _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control));
+            uint32_t bits = (uint32_t) _mm256_movemask_epi8(mask);
+            if (bits != 0) return begin + count_trailing_zeros(bits);
+            begin += 32;
+        }
+    }
+#endif
+#if defined(PROTOGEN_X_Y_Z__SSE2)
+    if (end - begin >= 16)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1F);
+        while (end - begin >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*) begin);
+            __m128i mask = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+            uint32_t bits = (uint32_t) _mm_movemask_epi8(mask);
+            if (bits != 0) return begin + count_trailing_zeros(bits);
+            begin += 16;
+        }
+    }
+#endif
+    while (begin < end)
+    {
+        unsigned char c = (unsigned char) *begin;
+        if (c < 0x20 || c == '"' || c == '\\') break;
+        ++begin;
+    }
+    return begin;
+}
+
+// Returns the first quote, bracket, brace or line feed in [begin, end)
+static inline const char *scan_structural( const char *begin, const char *end )
+{
+#if defined(PROTOGEN_X_Y_Z__AVX2)
+    if (end - begin >= 32)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i line_feed = _mm256_set1_epi8('\n');
+        const __m256i lower = _mm256_set1_epi8(0x20);
+        const __m256i open = _mm256_set1_epi8('{');
+        const __m256i close = _mm256_set1_epi8('}');
+        while (end - begin >= 32)
+        {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*) begin);
+            // '[' and ']' become '{' and '}' with the 0x20 bit set
+            __m256i folded = _mm256_or_si256(chunk, lower);
+            __m256i mask = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, line_feed)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)));
+            uint32_t bits = (uint32_t) _mm256_movemask_epi8(mask);
+            if (bits != 0) return begin + count_trailing_zeros(bits);
+            begin += 32;
+        }
+    }
+#endif
+#if defined(PROTOGEN_X_Y_Z__SSE2)
+    if (end - begin >= 16)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i line_feed = _mm_set1_epi8('\n');
+        const __m128i lower = _mm_set1_epi8(0x20);
+        const __m128i open = _mm_set1_epi8('{');
+        const __m128i close = _mm_set1_epi8('}');
+        while (end - begin >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*) begin);
+            __m128i folded = _mm_or_si128(chunk, lower);
+            __m128i mask = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, line_feed)),
+                _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)));
+            uint32_t bits = (uint32_t) _mm_movemask_epi8(mask);
+            if (bits != 0) return begin + count_trailing_zeros(bits);
+            begin += 16;
+        }
+    }
+#endif
+    while (begin < end)
+    {
+        char c = (char) (*begin | 0x20);
+        if (*begin == '"' || *begin == '\n' || c == '{' || c == '}') break;
+        ++begin;
+    }
+    return begin;
+}
+
+// Sets the bits of quotes, backslashes, structural characters and whitespaces in a 64 bytes block
+static inline void classify_block( const char *data, uint64_t &quote, uint64_t &backslash, uint64_t &op,
+    uint64_t &space )
+{
+    quote = backslash = op = space = 0;
+#if defined(PROTOGEN_X_Y_Z__SSE2)
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (data + i * 16));
+        // '[' and ']' become '{' and '}'
+        __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i ops = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+        __m128i spaces = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+        int shift = i * 16;
+        quote |= (uint64_t) (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))) << shift;
+        backslash |= (uint64_t) (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))) << shift;
+        op |= (uint64_t) (uint32_t) _mm_movemask_epi8(ops) << shift;
+        space |= (uint64_t) (uint32_t) _mm_movemask_epi8(spaces) << shift;
+    }
+#else
+    for (int i = 0; i < 64; ++i)
+    {
+        uint64_t bit = 1ULL << i;
+        switch (data[i])
+        {
+            case '"': quote |= bit; break;
+            case '\\': backslash |= bit; break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',': op |= bit; break;
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n': space |= bit; break;
+        }
+    }
+#endif
+}
+
+// Bit 'i' of the result is the XOR of the bits [0, i] of 'value'
+static inline uint64_t prefix_xor( uint64_t value )
+{
+    value ^= value << 1;
+    value ^= value << 2;
+    value ^= value << 4;
+    value ^= value << 8;
+    value ^= value << 16;
+    value ^= value << 32;
+    return value;
+}
+
+// Positions of the tokens of a JSON document (see 'Parameters::structural_index')
+struct structural_index
+{
+    static const uint32_t NO_MATCH = 0xFFFFFFFF;
+
+    // Offset of every token outside strings: structural characters, opening quotes and
+    // the first character of other values
+    std::vector<uint32_t> offsets;
+    // For opening brackets, the position in 'offsets' of the matching closing bracket
+    std::vector<uint32_t> matches;
+    // Open brackets while matching (kept to reuse its memory)
+    std::vector<uint32_t> stack;
+
+    bool build( const char *begin, const char *end )
+    {
+        static const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+        size_t size = (size_t) (end - begin);
+        if (size >= NO_MATCH) return false;
+        offsets.clear();
+        offsets.reserve(size / 4 + 1);
+
+        uint64_t prev_escaped = 0, prev_in_string = 0, prev_scalar = 0;
+        for (size_t i = 0; i < size; i += 64)
+        {
+            char block[64];
+            const char *data = begin + i;
+            if (size - i < 64)
+            {
+                memset(block, ' ', sizeof(block));
+                memcpy(block, data, size - i);
+                data = block;
+            }
+            uint64_t quote, backslash, op, space;
+            classify_block(data, quote, backslash, op, space);
+
+            // characters escaped by odd-length backslash sequences
+            backslash &= ~prev_escaped;
+            uint64_t follows_escape = backslash << 1 | prev_escaped;
+            uint64_t odd_starts = backslash & ~EVEN_BITS & ~follows_escape;
+            uint64_t even_starts = odd_starts + backslash;
+            prev_escaped = (even_starts < odd_starts) ? 1 : 0;
+            uint64_t escaped = (EVEN_BITS ^ (even_starts << 1)) & follows_escape;
+
+            // string contents, including the opening quote but not the closing one
+            quote &= ~escaped;
+            uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+            prev_in_string = (uint64_t) ((int64_t) in_string >> 63);
+
+            uint64_t outside = ~(in_string | quote);
+            uint64_t scalar = outside & ~(op | space);
+            uint64_t scalar_start = scalar & ~(scalar << 1 | prev_scalar);
+            prev_scalar = scalar >> 63;
+
+            uint64_t bits = (op & outside) | (quote & in_string) | scalar_start;
+            while (bits != 0)
+            {
+                offsets.push_back((uint32_t) (i + (size_t) count_trailing_zeros(bits)));
+                bits &= bits - 1;
+            }
+        }
+
+        // match brackets
+        matches.assign(offsets.size(), (uint32_t) NO_MATCH);
+        stack.clear();
+        for (uint32_t i = 0, t = (uint32_t) offsets.size(); i < t; ++i)
+        {
+            char c = begin[offsets[i]];
+            if (c == '{' || c == '[')
+                stack.push_back(i);
+            else
+            if (c == '}' || c == ']')
+            {
+                if (stack.empty()) break;
+                uint32_t open = stack.back();
+                stack.pop_back();
+                if (begin[offsets[open]] != (c == '}' ? '{' : '[')) break;
+                matches[open] = i;
+            }
+        }
+        return true;
+    }
+};
+
+// Computes the line and column of 'ptr' in the memory starting at 'begin'
+static inline void locate( const char *begin, const char *ptr, int &line, int &column )
+{
+    line = column = 1;
+    for (; begin < ptr; ++begin)
+    {
+        if (*begin == '\n')
+        {
+            ++line;
+            column = 1;
+        }
+        else
+            ++column;
+    }
+}
+
 class tokenizer
 {
     public:
-        tokenizer( istream &input, Parameters &params ) : input_(input), error_(params.error)
+        // Contiguous input: tokens are read straight from the memory range [begin, end)
+        tokenizer( const char *begin, const char *end, Parameters &params ) : cur_(begin), end_(end),
+            input_(nullptr), line_(1), column_(1), error_(params.error), base_(begin),
+            token_begin_(begin), error_at_(nullptr), lazy_position_(params.lazy_position),
+            use_index_(params.structural_index), indexed_(false), position_(0)
+        {
+            if (use_index_)
+                indexed_ = index_.build(begin, end);
+            next();
+        }
+
+        // Generic input: characters are pulled from the stream into an internal buffer
+        tokenizer( istream &input, Parameters &params ) : cur_(nullptr), end_(nullptr), input_(&input),
+            line_(1), column_(1), error_(params.error), base_(nullptr), token_begin_(nullptr),
+            error_at_(nullptr), lazy_position_(false), use_index_(false), indexed_(false), position_(0)
+        {
+            next();
+        }
+
+        // Restarts the tokenizer on another contiguous input, reusing the memory already allocated
+        void reset( const char *begin, const char *end )
         {
+            cur_ = base_ = token_begin_ = begin;
+            end_ = end;
+            input_ = nullptr;
+            line_ = column_ = 1;
+            position_ = 0;
+            error_at_ = nullptr;
+            indexed_ = use_index_ && index_.build(begin, end);
             next();
         }
 
-        int line() const { return input_.line(); }
-        int column() const { return input_.column(); }
+        int line() const
+        {
+            int line = line_, column;
+            if (lazy_position_) locate(base_, cur_, line, column);
+            return line;
+        }
+        int column() const
+        {
+            int line, column = column_;
+            if (lazy_position_) locate(base_, cur_, line, column);
+            return column;
+        }
 
         token &next()
         {
-            #define RETURN_TOKEN(x) do { current_ = token(x, "", line, column); input_.next(); return current_; } while (false)
+            #define RETURN_TOKEN(x) do { current_.id = x; current_.line = line; current_.column = column; next_char(); return current_; } while (false)
             current_.id = token_id::NONE;
             current_.value.clear();
-            while (!input_.eof())
+            current_.slice = nullptr;
+            if (indexed_)
             {
-                int c = input_.peek();
-                int line = input_.line();
-                int column = input_.column();
+                // jump to the next token
+                cur_ = (position_ < index_.offsets.size()) ? base_ + index_.offsets[position_++] : end_;
+                token_begin_ = cur_;
+            }
+            else
+            if (lazy_position_)
+            {
+                // skip whitespaces without tracking the position
+                while (cur_ < end_ && (*cur_ == ' ' || *cur_ == '\n' || *cur_ == '\r' || *cur_ == '\t')) ++cur_;
+                token_begin_ = cur_;
+            }
+            while (!eof())
+            {
+                int c = (unsigned char) *cur_;
+                int line = line_;
+                int column = column_;
                 switch (c)
                 {
                     case ' ':
                     case '\t':
                     case '\r':
                     case '\n':
-                        input_.next();
+                        next_char();
                         break;
                     case '{':
                         RETURN_TOKEN(token_id::OBJS);
@@ -328,7 +1237,16 @@ class tokenizer
                     case ',':
                         RETURN_TOKEN(token_id::COMMA);
                     case '"':
-                        return current_ = parse_string();
+                        current_.line = line;
+                        current_.column = column;
+                        if (parse_string(current_))
+                            current_.id = token_id::STRING;
+                        else
+                        {
+                            current_.value.clear();
+                            current_.slice = nullptr;
+                        }
+                        return current_;
                     case '-':
                     case '0':
                     case '1':
@@ -340,16 +1258,24 @@ class tokenizer
                     case '7':
                     case '8':
                     case '9':
-                        return current_ = parse_number();
+                        current_.id = token_id::NUMBER;
+                        current_.line = line;
+                        current_.column = column;
+                        parse_number(current_);
+                        if (!scalar_ended()) invalid_scalar();
+                        return current_;
                     default:
-                        std::string value = parse_identifier();
-                        if (value == "true") return current_ = token(token_id::BTRUE, "", line, column);
-                        if (value == "false") return current_ = token(token_id::BFALSE, "", line, column);
-                        if (value == "null") return current_ = token(token_id::NIL, "", line, column);
-                        return current_ = token(token_id::NONE, "", line, column);
+                        current_.line = line;
+                        current_.column = column;
+                        current_.id = parse_identifier();
+                        if (current_.id != token_id::NONE && !scalar_ended()) invalid_scalar();
+                        return current_;
                 }
             }
-            return current_ = token(token_id::EOS, "", input_.line(), input_.column());
+            current_.id = token_id::EOS;
+            current_.line = line_;
+            current_.column = column_;
+            return current_;
             #undef RETURN_TOKEN
         }
         token &peek() { return current_; }
@@ -370,56 +1296,314 @@ class tokenizer
             error_.message = msg;
             error_.line = current_.line;
             error_.column = current_.column;
+            if (indexed_ || lazy_position_)
+            {
+                error_at_ = token_begin_;
+                locate(base_, token_begin_, error_.line, error_.column);
+            }
             return PGR_ERROR;
         }
+        // Position in the contiguous input of the error reported by 'error' (indexed mode and lazy
+        // position only)
+        const char *error_position() const { return error_at_; }
         void set_error(ErrorInfo &err)
         {
             error_ = err;
         }
         int ignore( ) { return ignore_value(); }
 
+        // Appends the text of the current object or array to 'out' and moves to the token after
+        // it. Only strings and nesting are tracked, so the contents are not validated.
+        bool capture( std::string &out )
+        {
+            if (current_.id != token_id::OBJS && current_.id != token_id::ARRS) return false;
+            if (indexed_)
+            {
+                uint32_t match = index_.matches[position_ - 1];
+                if (match == structural_index::NO_MATCH) return false;
+                out.append(token_begin_, base_ + index_.offsets[match] + 1);
+                position_ = match + 1;
+            }
+            else
+            {
+                out += (current_.id == token_id::OBJS) ? '{' : '[';
+                if (!skip_raw(&out)) return false;
+            }
+            next();
+            return true;
+        }
+
     protected:
+        static const size_t BUFFER_SIZE = 4096;
+
         token current_;
-        istream &input_;
+        // Current position and end of the input window
+        const char *cur_, *end_;
+        // Generic input and its buffer (unused for contiguous inputs)
+        istream *input_;
+        std::string buffer_;
+        // Position of 'cur_' in the input
+        int line_, column_;
         ErrorInfo &error_;
+        // Beginning of the contiguous input
+        const char *base_;
+        // Beginning of the current token and of the token with the error (indexed mode and lazy
+        // position only)
+        const char *token_begin_, *error_at_;
+        // Whether line and column are computed only on errors
+        bool lazy_position_;
+        // Structural index and position of the next token in it
+        bool use_index_, indexed_;
+        structural_index index_;
+        size_t position_;
+        // Kind of the open brackets beyond the 64th level in 'skip_raw'
+        std::vector<char> nesting_;
+
+        // Whether the number or literal just parsed ends where the next token begins. The index
+        // does not split scalars like '1x' and 'true1', so the junk would be skipped otherwise.
+        bool scalar_ended() const
+        {
+            if (!indexed_ || cur_ == end_) return true;
+            switch (*cur_)
+            {
+                case ' ':
+                case '\t':
+                case '\r':
+                case '\n':
+                case '{':
+                case '}':
+                case '[':
+                case ']':
+                case ':':
+                case ',':
+                    return true;
+            }
+            return position_ < index_.offsets.size() && cur_ == base_ + index_.offsets[position_];
+        }
+
+        void invalid_scalar()
+        {
+            current_.id = token_id::NONE;
+            current_.value.clear();
+            current_.slice = nullptr;
+            error(error_code::PGERR_INVALID_VALUE, "invalid value");
+        }
+
+        // Jumps over the current object or array using the structural index
+        bool skip_indexed()
+        {
+            if (!indexed_ || position_ == 0) return false;
+            uint32_t match = index_.matches[position_ - 1];
+            if (match == structural_index::NO_MATCH) return false;
+            position_ = match + 1;
+            next();
+            return true;
+        }
+
+        // Moves the position in the structural index to the first token at or after 'cur_', after
+        // the input was consumed without the index (e.g. by 'skip_raw')
+        void resync()
+        {
+            if (!indexed_) return;
+            auto begin = index_.offsets.begin() + (std::ptrdiff_t) position_;
+            auto it = std::lower_bound(begin, index_.offsets.end(), (uint32_t) (cur_ - base_));
+            position_ = (size_t) (it - index_.offsets.begin());
+        }
+
+        // Moves past the end of the current object or array over the raw input, tracking only
+        // strings and nesting. The characters consumed are appended to 'out', if not null. On
+        // failure, the current token is moved to the position of the error.
+        bool skip_raw( std::string *out )
+        {
+            // kind of the open brackets (bit set for arrays); levels beyond 64 go to 'nesting_'
+            uint64_t kinds = (current_.id == token_id::ARRS) ? 1 : 0;
+            size_t depth = 1;
+            bool in_string = false;
+            while (!eof())
+            {
+                const char *mark = cur_;
+                while (cur_ < end_)
+                {
+                    if (in_string)
+                    {
+                        const char *p = scan_string(cur_, end_);
+                        column_ += (int) (p - cur_);
+                        cur_ = p;
+                        if (cur_ == end_) break;
+                        if (*cur_ == '"')
+                            in_string = false;
+                        else
+                        if (*cur_ == '\\')
+                        {
+                            // the escaped character may be in the next window
+                            next_char();
+                            if (cur_ == end_)
+                            {
+                                if (out != nullptr) out->append(mark, cur_);
+                                bool more = !eof();
+                                mark = cur_;
+                                if (!more) break;
+                            }
+                        }
+                        next_char();
+                        continue;
+                    }
+
+                    const char *p = scan_structural(cur_, end_);
+                    column_ += (int) (p - cur_);
+                    cur_ = p;
+                    if (cur_ == end_) break;
+                    int line = line_;
+                    int column = column_;
+                    char c = *cur_;
+                    next_char();
+                    if (c == '"')
+                        in_string = true;
+                    else
+                    if (c == '{' || c == '[')
+                    {
+                        uint64_t kind = (c == '[') ? 1 : 0;
+                        if (depth < 64)
+                            kinds = (kinds & ~(1ULL << depth)) | (kind << depth);
+                        else
+                            nesting_.push_back((char) kind);
+                        ++depth;
+                    }
+                    else
+                    if (c == '}' || c == ']')
+                    {
+                        --depth;
+                        uint64_t kind = (depth < 64) ? (kinds >> depth) & 1 : (uint64_t) nesting_.back();
+                        if (depth >= 64) nesting_.pop_back();
+                        if (kind != ((c == ']') ? 1U : 0U))
+                        {
+                            nesting_.clear();
+                            return skip_error(cur_ - 1, line, column);
+                        }
+                        if (depth == 0)
+                        {
+                            if (out != nullptr) out->append(mark, cur_);
+                            return true;
+                        }
+                    }
+                }
+                if (out != nullptr) out->append(mark, cur_);
+            }
+            nesting_.clear();
+            return skip_error(cur_, line_, column_);
+        }
+
+        bool skip_error( const char *ptr, int line, int column )
+        {
+            token_begin_ = ptr;
+            current_.line = line;
+            current_.column = column;
+            return false;
+        }
+
+        // Refills the input window from the generic input. Returns false at the end of the input.
+        bool fill()
+        {
+            if (input_ == nullptr) return false;
+            if (buffer_.empty()) buffer_.resize(BUFFER_SIZE);
+            char *data = &buffer_[0];
+            size_t count = input_->read(data, BUFFER_SIZE);
+            cur_ = data;
+            end_ = data + count;
+            return count > 0;
+        }
+
+        bool eof()
+        {
+            return cur_ == end_ && !fill();
+        }
+
+        // Returns the current character or zero at the end of the input
+        int peek_char()
+        {
+            if (eof()) return 0;
+            return (unsigned char) *cur_;
+        }
+
+        void next_char()
+        {
+            if (eof()) return;
+            if (!lazy_position_)
+            {
+                if (*cur_ == '\n')
+                {
+                    ++line_;
+                    column_ = 1;
+                }
+                else
+                    ++column_;
+            }
+            ++cur_;
+        }
 
-        std::string parse_identifier()
+        token_id parse_identifier()
         {
-            std::string value;
-            while (!input_.eof())
+            char value[6];
+            size_t size = 0;
+            while (!eof())
             {
-                int c = input_.peek();
+                int c = (unsigned char) *cur_;
                 if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
                 {
-                    value += (char) c;
-                    input_.next();
+                    if (size < sizeof(value)) value[size] = (char) c;
+                    ++size;
+                    next_char();
                 }
                 else
                     break;
             }
-            return value;
+            if (size == 4 && memcmp(value, "true", 4) == 0) return token_id::BTRUE;
+            if (size == 5 && memcmp(value, "false", 5) == 0) return token_id::BFALSE;
+            if (size == 4 && memcmp(value, "null", 4) == 0) return token_id::NIL;
+            return token_id::NONE;
         }
 
-        token parse_string()
+        bool parse_string( token &tt )
         {
             int32_t lead = 0;
-            std::string value;
-            int line = input_.line();
-            int column = input_.column();
-            if (input_.peek() != '"') goto ESCAPE;
-            while (!input_.eof())
-            {
-                input_.next();
-                int c = input_.peek();
+            next_char();
+            // strings without escape sequences are referenced in contiguous inputs
+            if (input_ == nullptr)
+            {
+                const char *p = scan_string(cur_, end_);
+                if (p != end_ && *p == '"')
+                {
+                    tt.slice = cur_;
+                    tt.slice_size = (size_t) (p - cur_);
+                    column_ += (int) (p - cur_) + 1;
+                    cur_ = p + 1;
+                    return true;
+                }
+            }
+
+            std::string &value = tt.value;
+            while (!eof())
+            {
+                // copy the run of plain characters at once
+                const char *p = scan_string(cur_, end_);
+                if (p != cur_)
+                {
+                    value.append(cur_, p);
+                    column_ += (int) (p - cur_);
+                    cur_ = p;
+                    continue;
+                }
+
+                int c = (unsigned char) *cur_;
                 if (c == '"')
                 {
-                    input_.next();
-                    return token(token_id::STRING, value);
+                    next_char();
+                    return true;
                 }
                 if (c == '\\')
                 {
-                    input_.next();
-                    c = input_.peek();
+                    next_char();
+                    c = peek_char();
                     switch (c)
                     {
                         case '"':  value += '"'; break;
@@ -432,20 +1616,20 @@ class tokenizer
                         case 't':  value += '\t'; break;
                         case 'u':
                             if (!parse_escaped_utf8(value, lead))
-                                goto ESCAPE;
+                                return false;
                             break;
-                        default: goto ESCAPE;
+                        default: return false;
                     }
                 }
                 else
                 {
                     if (c == 0)
-                        goto ESCAPE;
+                        return false;
                     value += (char) c;
                 }
+                next_char();
             }
-            ESCAPE:
-            return token(token_id::NONE, "", line, column);
+            return false;
         }
 
         bool parse_escaped_utf8(std::string &value, int32_t &lead)
@@ -453,8 +1637,8 @@ class tokenizer
             char temp[5] = {0};
             for (int i = 0; i < 4; ++i)
             {
-                input_.next();
-                auto c = input_.peek();
+                next_char();
+                auto c = peek_char();
                 if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f'))
                     temp[i] = (char) c;
                 else
@@ -513,65 +1697,37 @@ class tokenizer
         {
             for (auto c : keyword)
             {
-                if (input_.peek() != c) return false;
-                input_.next();
+                if (peek_char() != c) return false;
+                next_char();
             }
             return true;
         }
 
-        token parse_number() // TODO ensure number syntax according to RFC-4627 section 2.4
+        static bool is_number_char( int c )
         {
-            std::string value;
-            int line = input_.line();
-            int column = input_.column();
-            while (!input_.eof())
-            {
-                int c = input_.peek();
-                if (c == '.' || (c >= '0' && c <= '9') || c == 'e' || c == 'E' || c == '+' || c == '-')
-                {
-                    value += (char) c;
-                    input_.next();
-                }
-                else
-                    break;
-            }
-            return token(token_id::NUMBER, value, line, column);
+            return (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-';
         }
 
-        int ignore_array()
+        // The number syntax is checked by the conversion functions
+        void parse_number( token &tt )
         {
-            if (!expect(token_id::ARRS))
-                return error(error_code::PGERR_IGNORE_FAILED, "invalid array");
-
-            while (peek().id != token_id::ARRE)
+            if (input_ == nullptr)
             {
-                int result = ignore_value();
-                if (result != PGERR_OK) return result;
-                if (!expect(token_id::COMMA)) break;
+                const char *p = cur_;
+                while (p < end_ && is_number_char((unsigned char) *p)) ++p;
+                tt.slice = cur_;
+                tt.slice_size = (size_t) (p - cur_);
+                column_ += (int) (p - cur_);
+                cur_ = p;
+                return;
             }
-            if (!expect(token_id::ARRE))
-                return error(error_code::PGERR_IGNORE_FAILED, "invalid array");
-            return PGR_OK;
-        }
-
-        int ignore_object()
-        {
-            if (!expect(token_id::OBJS))
-                return error(error_code::PGERR_IGNORE_FAILED, "invalid object");
-
-            while (peek().id != token_id::OBJE)
+            while (!eof())
             {
-                if (!expect(token_id::STRING))
-                    return error(error_code::PGERR_IGNORE_FAILED, "expected field name");
-                if (!expect(token_id::COLON))
-                    return error(error_code::PGERR_IGNORE_FAILED, "expected colon");
-                int result = ignore_value();
-                if (result != PGERR_OK) return result;
-                if (!expect(token_id::COMMA)) break;
+                int c = (unsigned char) *cur_;
+                if (!is_number_char(c)) break;
+                tt.value += (char) c;
+                next_char();
             }
-            if (!expect(token_id::OBJE))
-                return error(error_code::PGERR_IGNORE_FAILED, "invalid object");
-            return PGR_OK;
         }
 
         int ignore_value()
@@ -582,17 +1738,22 @@ class tokenizer
                 case token_id::EOS:
                     return error(error_code::PGERR_IGNORE_FAILED, "end of stream");
                 case token_id::OBJS:
-                    return ignore_object();
                 case token_id::ARRS:
-                    return ignore_array();
+                    // no tokens are produced for the contents of the subtree
+                    if (skip_indexed()) return PGR_OK;
+                    if (!skip_raw(nullptr))
+                        return error(error_code::PGERR_IGNORE_FAILED, "invalid object or array");
+                    resync();
+                    next();
+                    return PGR_OK;
                 case token_id::STRING:
                 case token_id::NUMBER:
                 case token_id::NIL:
                 case token_id::BTRUE:
                 case token_id::BFALSE:
                 {
-                    auto tt = next();
-                    if (tt.id == token_id::NONE || tt.id == token_id::EOS)
+                    token_id id = next().id;
+                    if (id == token_id::NONE || id == token_id::EOS)
                         return error(PGERR_IGNORE_FAILED, "end of stream");
                     return PGERR_OK;
                 }
@@ -624,6 +1785,128 @@ static inline std::string reveal( const std::string &value )
 	return result;
 }
 
+// Returns the text written before a field value: a comma, the quoted label and a colon
+static inline std::string json_key( const std::string &label )
+{
+    return ",\"" + label + "\":";
+}
+
+// Compares 'size' bytes of 'value' with the obfuscated 'text' (see 'reveal')
+static inline bool equal_obfuscated( const char *value, const char *text, size_t size )
+{
+    uint8_t mask = rol<uint8_t>(0x93U, (int) (size % 8));
+    for (size_t i = 0; i < size; ++i)
+        if ((uint8_t) ((uint8_t) value[i] ^ mask) != (uint8_t) text[i]) return false;
+    return true;
+}
+
+// Read-only view of the contents of a file. The file is memory-mapped where supported,
+// otherwise it is loaded into memory.
+class mapped_file
+{
+    public:
+        mapped_file() : data_(nullptr), size_(0), mapped_(false) {}
+        mapped_file( const mapped_file& ) = delete;
+        mapped_file &operator=( const mapped_file& ) = delete;
+        ~mapped_file() { close(); }
+
+        bool open( const char *path )
+        {
+            close();
+            #ifdef PROTOGEN_X_Y_Z__POSIX
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) return false;
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size < 0)
+            {
+                ::close(fd);
+                return false;
+            }
+            if (!S_ISREG(info.st_mode))
+            {
+                // pipes, devices and pseudo-files report no size, so they are read to the end
+                bool loaded = load(fd);
+                ::close(fd);
+                return loaded;
+            }
+            size_ = (size_t) info.st_size;
+            if (size_ > 0)
+            {
+                void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED)
+                {
+                    ::close(fd);
+                    size_ = 0;
+                    return false;
+                }
+                #ifdef MADV_SEQUENTIAL
+                madvise(data, size_, MADV_SEQUENTIAL);
+                #endif
+                data_ = (const char*) data;
+                mapped_ = true;
+            }
+            ::close(fd);
+            #else
+            FILE *fp = fopen(path, "rb");
+            if (fp == nullptr) return false;
+            char temp[4096];
+            size_t count;
+            while ((count = fread(temp, 1, sizeof(temp), fp)) > 0)
+                buffer_.append(temp, count);
+            bool failed = ferror(fp) != 0;
+            fclose(fp);
+            if (failed) return false;
+            size_ = buffer_.size();
+            #endif
+            if (data_ == nullptr) data_ = buffer_.data();
+            return true;
+        }
+
+        void close()
+        {
+            #ifdef PROTOGEN_X_Y_Z__POSIX
+            if (mapped_) munmap((void*) data_, size_);
+            #endif
+            buffer_.clear();
+            data_ = nullptr;
+            size_ = 0;
+            mapped_ = false;
+        }
+
+        const char *data() const { return data_; }
+        size_t size() const { return size_; }
+
+    protected:
+        const char *data_;
+        size_t size_;
+        bool mapped_;
+        // File contents when memory mapping is not available
+        std::string buffer_;
+
+        #ifdef PROTOGEN_X_Y_Z__POSIX
+        // Reads the file descriptor to the end into 'buffer_'
+        bool load( int fd )
+        {
+            char temp[4096];
+            while (true)
+            {
+                ssize_t count = ::read(fd, temp, sizeof(temp));
+                if (count == 0) break;
+                if (count < 0)
+                {
+                    if (errno == EINTR) continue;
+                    buffer_.clear();
+                    return false;
+                }
+                buffer_.append(temp, (size_t) count);
+            }
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+            return true;
+        }
+        #endif
+};
+
 // Parent class for messages
 template<typename T, typename J>
 struct message
@@ -632,68 +1915,85 @@ struct message
     typedef J serializer_type;
     virtual ~message() = default;
     virtual bool deserialize( istream &in, Parameters *params = nullptr ) = 0;
-    virtual bool serialize( ostream &out, Parameters *params = nullptr ) const = 0;
+    virtual bool serialize( output_buffer &out, Parameters *params = nullptr ) const = 0;
 
+    // The stream buffer is read in blocks up to the end of the document. Sets 'failbit' if the
+    // document is invalid and 'eofbit' if the end of the stream was reached.
     virtual bool deserialize( std::istream &in, Parameters *params = nullptr )
     {
-        bool skip = in.flags() & std::ios_base::skipws;
-        std::noskipws(in);
-        std::istream_iterator<char> end;
-        std::istream_iterator<char> begin(in);
-        iterator_istream<std::istream_iterator<char>> is(begin, end);
+        std::istream::sentry sentry(in, true);
+        if (!sentry || in.rdbuf() == nullptr)
+        {
+            if (params != nullptr)
+                params->error = ErrorInfo(error_code::PGERR_INVALID_FILE, "unable to read the stream", 0, 0);
+            in.setstate(std::ios::failbit);
+            return false;
+        }
+        document_istream is(*in.rdbuf());
         bool result = deserialize(is, params);
-        if (skip) std::skipws(in);
+        std::ios::iostate state = std::ios::goodbit;
+        if (is.reached_eof()) state |= std::ios::eofbit;
+        if (!result) state |= std::ios::failbit;
+        in.setstate(state);
         return result;
     }
 
+    // Contiguous inputs are tokenized directly from memory
+    virtual bool deserialize( const char *in, size_t len, Parameters *params = nullptr ) = 0;
+
     virtual bool deserialize( const std::string &in, Parameters *params = nullptr )
     {
-        iterator_istream<std::string::const_iterator> is(in.begin(), in.end());
-        return deserialize(is, params);
+        return deserialize(in.data(), in.size(), params);
     }
 
-    virtual bool deserialize( const char *in, size_t len, Parameters *params = nullptr )
+    virtual bool deserialize( const std::vector<char> &in, Parameters *params = nullptr )
     {
-        auto begin = mem_const_iterator<char>(in, len);
-        auto end = mem_const_iterator<char>(in + len, 0);
-        iterator_istream<mem_const_iterator<char>> is(begin, end);
-        return deserialize(is, params);
+        return deserialize(in.data(), in.size(), params);
     }
 
-    virtual bool deserialize( const std::vector<char> &in, Parameters *params = nullptr )
+    // Decodes the contents of a file, memory-mapped where supported
+    virtual bool deserialize_file( const std::string &path, Parameters *params = nullptr )
     {
-        iterator_istream<std::vector<char>::const_iterator> is(in.begin(), in.end());
-        return deserialize(is, params);
+        mapped_file file;
+        if (!file.open(path.c_str()))
+        {
+            if (params != nullptr)
+                params->error = ErrorInfo(error_code::PGERR_INVALID_FILE, "unable to read the file", 0, 0);
+            return false;
+        }
+        return deserialize(file.data(), file.size(), params);
     }
 
+    // The JSON is appended to the string directly
     virtual bool serialize( std::string &out, Parameters *params = nullptr ) const
     {
-        typedef std::back_insert_iterator<std::string> ittype;
-        ittype begin(out);
-        iterator_ostream<ittype> os(begin);
+        output_buffer os(out);
+        return serialize(os, params);
+    }
+
+    // The JSON is written in chunks (see 'output_buffer')
+    virtual bool serialize( ostream &out, Parameters *params = nullptr ) const
+    {
+        output_buffer os(out);
         return serialize(os, params);
     }
 
     virtual bool serialize( std::ostream &out, Parameters *params = nullptr ) const
     {
-        typedef std::ostream_iterator<char> ittype;
-        ittype begin(out);
-        iterator_ostream<ittype> os(begin);
+        output_buffer os(out);
         return serialize(os, params);
     }
 
+    // Writes at most 'len' characters, without null terminator
     virtual bool serialize( char *in, size_t len, Parameters *params = nullptr )
     {
-        auto begin = mem_iterator<char>(in, len);
-        iterator_ostream<mem_iterator<char>> os(begin);
+        output_buffer os(in, len);
         return serialize(os, params);
     }
 
     virtual bool serialize( std::vector<char> &out, Parameters *params = nullptr ) const
     {
-        typedef std::back_insert_iterator<std::vector<char>> ittype;
-        ittype begin(out);
-        iterator_ostream<ittype> os(begin);
+        output_buffer os(out);
         return serialize(os, params);
     }
 
@@ -20,7 +20,14 @@
 #include <list>
 #include <vector>
 #include <sstream>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+
+#define PROTOGEN_3_0_0__THREADS
+
+// schema without repeated fields first, so its header is compiled without 'json-array.hh'
+#include <test8.pg.hh>
 #include <test1.pg.hh>
 #include <test3.pg.hh>
 #include <test7.pg.hh>
@@ -167,11 +174,50 @@ bool RUN_TEST4( int argc, char **argv)
     bool result = true;
 
     int i = 0;
-    for (; result && CASES[i].line != 0; ++i)
+    for (int mode = 0; result && mode < 3; ++mode)
+    {
+        params.structural_index = mode == 1;
+        params.lazy_position = mode == 2;
+        for (i = 0; result && CASES[i].line != 0; ++i)
+        {
+            result &= !temp.deserialize(CASES[i].json, &params);
+            result &= CASES[i].line == params.error.line && CASES[i].col == params.error.column;
+            result &= CASES[i].code == params.error.code;
+        }
+    }
+
+    // the structural index does not split scalars, so the junk after them is checked apart
+    const char *JUNK[] = { "{\"c\":1x}", "{\"m\":true1}", "{\"blip\":null1}" };
+    for (size_t j = 0; result && j < sizeof(JUNK) / sizeof(JUNK[0]); ++j)
+    {
+        types::Basic basic;
+        Parameters indexed;
+        indexed.structural_index = true;
+        result &= !basic.deserialize(std::string(JUNK[j]), &indexed);
+        result &= indexed.error.code == error_code::PGERR_INVALID_VALUE;
+        result &= indexed.error.line == 1 && indexed.error.column == (j < 2 ? 6 : 9);
+        if (!result) std::cerr << "   Accepted junk in indexed mode: '" << JUNK[j] << '\'' << std::endl;
+    }
+
+    // unknown members skipped over the raw input when the index has no matching bracket
     {
-        result &= !temp.deserialize(CASES[i].json, &params);
-        result &= CASES[i].line == params.error.line && CASES[i].col == params.error.column;
-        result &= CASES[i].code == params.error.code;
+        struct unmatched_tokenizer : tokenizer
+        {
+            unmatched_tokenizer( const std::string &text, Parameters &params ) :
+                tokenizer(text.data(), text.data() + text.size(), params)
+            {
+                index_.matches.assign(index_.matches.size(), (uint32_t) structural_index::NO_MATCH);
+            }
+        };
+        std::string text = "{\"c\":1,\"blip\":{\"x\":[1,{\"y\":\"}]\"}],\"z\":{}},\"e\":7,\"m\":true}";
+        json_context ctx;
+        ctx.params.structural_index = true;
+        unmatched_tokenizer tok(text, ctx.params);
+        ctx.tok = &tok;
+        types::Basic basic;
+        result &= json<types::Basic>::read(ctx, basic) == PGR_OK && tok.peek().id == token_id::EOS;
+        result &= basic.c == 1 && basic.e == 7U && basic.m == true;
+        if (!result) std::cerr << "   Lost the position after an unknown member in indexed mode" << std::endl;
     }
 
     std::cerr << "[TEST #4] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
@@ -427,6 +473,25 @@ bool RUN_TEST8( int argc, char **argv)
     if (!test8_iteration(VALUES, true))
         return false;
 
+    // null, empty and non-empty strings are kept apart
+    static const char *STRINGS[][2] = {
+        { "null", "{}" },
+        { "\"\"", "{\"name\":\"\"}" },
+        { "\"text\"", "{\"name\":\"text\"}" },
+    };
+    for (auto &item : STRINGS)
+    {
+        phonebook::Person person;
+        person.name = "previous";
+        std::string json;
+        if (!person.deserialize(std::string("{\"name\":") + item[0] + "}") || !person.serialize(json) ||
+            json != item[1] || person.name.empty() != (json == "{}"))
+        {
+            std::cerr << "[TEST #8] Failed!" << std::endl;
+            return false;
+        }
+    }
+
     std::cerr << "[TEST #8] Passed!" << std::endl;
     return true;
 }
@@ -481,8 +546,8 @@ bool RUN_TEST10( int argc, char **argv)
 
     if (!protogen_3_0_0::serialize_array(people, json1))
         goto FAILED;
-    //if (!protogen_3_0_0::deserialize_array(people, json1.c_str(), json1.length()))
-    //    goto FAILED;
+    if (!protogen_3_0_0::deserialize_array(people, json1.c_str(), json1.length()))
+        goto FAILED;
     if (!protogen_3_0_0::deserialize_array(people, json1))
         goto FAILED;
 
@@ -499,6 +564,1139 @@ bool RUN_TEST10( int argc, char **argv)
     return false;
 }
 
+bool RUN_TEST11( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    // special characters at every position of strings crossing the 16 and 32 bytes boundaries
+    static const char *SPECIALS[] = { "\"", "\\", "\n", "\t", "\x1F", "ß", "이", nullptr };
+
+    for (int s = 0; SPECIALS[s] != nullptr; ++s)
+    {
+        for (size_t length = 1; length <= 70; ++length)
+        {
+            for (size_t pos = 0; pos < length; ++pos)
+            {
+                std::string value(length, 'x');
+                value.replace(pos, 1, SPECIALS[s]);
+
+                types::Basic object1;
+                object1.n = value;
+                std::string json;
+                object1.serialize(json);
+                types::Basic object2;
+                if (!object2.deserialize(json) || object2.n != value)
+                {
+                    std::cerr << "[TEST #11] Failed!" << std::endl;
+                    std::cerr << "   " << json << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    std::cerr << "[TEST #11] Passed!" << std::endl;
+    return true;
+}
+
+bool RUN_TEST12( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    static const char *JSON =
+        "{ \"0\" : { \"a\": [1, 2, {\"b\": \"}]\\\"{\"}], \"c\": {}},\n"
+        "  \"1\" : \"Chocolate\\\\\", \"9\": [[[]], {\"x\": \"\\\\\"}],\n"
+        "  \"4\" : [\"milk\", \"sugar\"], \"2\": 500 }";
+
+    bool result = true;
+    std::string json1;
+    for (int indexed = 0; indexed < 2; ++indexed)
+    {
+        Parameters params;
+        params.structural_index = indexed != 0;
+        options::Cake cake;
+        result &= cake.deserialize(JSON, strlen(JSON), &params);
+        result &= cake.name == "Chocolate\\" && cake.weight == 500 && cake.ingredients.size() == 2;
+
+        std::string json2;
+        cake.serialize(json2);
+        if (indexed == 0)
+            json1 = json2;
+        else
+            result &= json1 == json2;
+    }
+
+    // deep nesting and mismatched brackets in unknown subtrees
+    std::string deep = std::string(100, '[') + "{\"a\": \"]\"}" + std::string(100, ']');
+    std::string json3 = "{\"9\": " + deep + ", \"2\": 7}";
+    std::string json4 = "{\"9\": " + deep.substr(0, 150) + "}" + deep.substr(150) + "}";
+    for (int input = 0; input < 2; ++input)
+    {
+        Parameters params;
+        options::Cake cake;
+        if (input == 0)
+            result &= cake.deserialize(json3, &params) && cake.weight == 7;
+        else
+        {
+            iterator_istream<std::string::const_iterator> is(json3.begin(), json3.end());
+            result &= cake.deserialize(is, &params) && cake.weight == 7;
+        }
+        result &= !cake.deserialize(json4, &params) && params.error.code == PGERR_IGNORE_FAILED &&
+            params.error.column == 157;
+    }
+
+    std::cerr << "[TEST #12] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    std::cerr << "   " << json1 << std::endl;
+    return result;
+}
+
+bool RUN_TEST13( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    bool result = true;
+    types::Basic object;
+    const std::string json = "{\"c\":-2147483648,\"d\":-9223372036854775808,\"f\":18446744073709551615,"
+        "\"a\":1.5e-3,\"b\":0.1,\"e\":1e3,\"g\":-0}";
+    result &= object.deserialize(json);
+    result &= object.c == std::numeric_limits<int32_t>::min();
+    result &= object.d == std::numeric_limits<int64_t>::min();
+    result &= object.f == std::numeric_limits<uint64_t>::max();
+    result &= object.a == 1.5e-3 && object.b == 0.1F && object.e == 1000U && object.g == 0;
+
+    // integral values beyond 2^53 are exact and single precision values are rounded once
+    result &= object.deserialize("{\"d\":9007199254740993.0,\"f\":1844674407370955161.5e1,"
+        "\"c\":-12.50e1,\"h\":0.0e-7,\"b\":5.228726229993252e22}");
+    result &= object.d == (int64_t) 9007199254740993LL && object.f == std::numeric_limits<uint64_t>::max();
+    result &= object.c == -125 && object.h == (int64_t) 0 && object.b == 5.228726229993252e22F;
+
+    // out of range, fractional or malformed numbers
+    static const char *INVALID[] = { "{\"c\":2147483648}", "{\"e\":-1}", "{\"c\":1.5}", "{\"c\":01}",
+        "{\"a\":1.}", "{\"a\":-}", "{\"a\":1e}", "{\"f\":18446744073709551616}",
+        "{\"d\":9007199254740993.5}", "{\"f\":1.8446744073709551616e19}", nullptr };
+    for (int i = 0; INVALID[i] != nullptr; ++i)
+    {
+        Parameters params;
+        result &= !object.deserialize(INVALID[i], &params) && params.error.code == PGERR_INVALID_VALUE;
+    }
+
+    std::cerr << "[TEST #13] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST14( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    static const char *JSON =
+        "  {\"1\":\"Choco\\\"{late\",\"9\":[{}, [\"]\"]],\"2\":500}\n"
+        "{\"1\":\"Vanilla\",\"4\":[\"milk\"]} [{\"2\":1},{\"2\":2}] {\"1\": ]";
+    size_t length = strlen(JSON);
+
+    bool result = true;
+    for (size_t chunk = 1; chunk <= 9; ++chunk)
+    {
+        PushDecoder<options::Cake> decoder;
+        for (size_t offset = 0; offset < length; offset += chunk)
+            decoder.feed(JSON + offset, std::min(chunk, length - offset));
+        result &= decoder.status() == PGD_DONE && decoder.value().name == "Choco\"{late" &&
+            decoder.value().weight == 500;
+        decoder.reset();
+        result &= decoder.feed(nullptr, 0) == PGD_DONE && decoder.value().name == "Vanilla" &&
+            decoder.value().ingredients.size() == 1 && decoder.value().weight.empty();
+        decoder.reset();
+        // arrays are not messages
+        result &= decoder.feed(nullptr, 0) == PGD_ERROR;
+    }
+
+    // members of messages are decoded as soon as they are received and their bytes are released
+    {
+        PushDecoder<options::Cake> decoder;
+        result &= decoder.feed("{\"1\":\"Cake\"", 11) == PGD_NEED_MORE;
+        std::string member = ",\"9\":[\"" + std::string(200, 'x') + "\"]";
+        for (int i = 0; i < 100; ++i)
+            result &= decoder.feed(member.data(), member.size()) == PGD_NEED_MORE;
+        result &= decoder.buffered() < 2 * member.size() && decoder.value().name == "Cake";
+        result &= decoder.feed(",\"2\":7}", 7) == PGD_DONE && decoder.value().weight == 7;
+        decoder.reset();
+        result &= decoder.feed("{\"1\":\"A\",\n \"2\":true}", 21) == PGD_ERROR &&
+            decoder.error().line == 2 && decoder.error().column == 6;
+        decoder.reset();
+        result &= decoder.feed("{\"1\":\"A\",}", 10) == PGD_ERROR;
+    }
+
+    PushDecoder< std::vector<options::Cake> > decoder;
+    const char *array = strstr(JSON, " [{");
+    result &= decoder.feed(array, strlen(array)) == PGD_DONE && decoder.value().size() == 2 &&
+        decoder.value()[1].weight == 2;
+    decoder.reset();
+    // the error is the one 'deserialize' finds before the framing error
+    result &= decoder.feed(nullptr, 0) == PGD_ERROR && decoder.error().line == 1 &&
+        decoder.error().column == 2 && decoder.error().code == PGERR_INVALID_ARRAY;
+
+    // elements of top-level arrays are decoded as they complete and their bytes are dropped
+    decoder.reset();
+    result &= decoder.feed("[", 1) == PGD_NEED_MORE;
+    std::string element = "{\"1\":\"Cake\",\"2\":7},\n";
+    for (int i = 0; i < 1000; ++i)
+    {
+        result &= decoder.feed(element.data(), element.size()) == PGD_NEED_MORE;
+        result &= decoder.value().size() == (size_t) i + 1 && decoder.buffered() <= element.size() + 1;
+    }
+    result &= decoder.feed("{\"2\":8}]", 8) == PGD_DONE && decoder.value().size() == 1001 &&
+        decoder.value().back().weight == 8;
+    decoder.reset();
+    result &= decoder.feed("[", 1) == PGD_NEED_MORE && decoder.feed(element.data(), element.size()) == PGD_NEED_MORE;
+    result &= decoder.feed(" {\"2\":true}]", 13) == PGD_ERROR && decoder.error().line == 2 &&
+        decoder.error().column == 7 && decoder.error().code == PGERR_INVALID_VALUE;
+
+    // byte by byte, decoded bytes are released in bulk and positions stay correct
+    decoder.reset();
+    std::string bytes = "[" + element + element + element + " {\"2\":true}]";
+    for (size_t i = 0; i + 1 < bytes.size(); ++i)
+    {
+        result &= decoder.feed(bytes.data() + i, 1) == PGD_NEED_MORE;
+        result &= decoder.buffered() <= 2 * element.size() + 1;
+    }
+    result &= decoder.feed(&bytes.back(), 1) == PGD_ERROR && decoder.value().size() == 3 &&
+        decoder.error().line == 4 && decoder.error().column == 7;
+    static const char *INVALID[] = { "[{}, ]", "[,{}]", "[{} {}]", "[1]" };
+    for (size_t i = 0; i < sizeof(INVALID) / sizeof(INVALID[0]); ++i)
+    {
+        decoder.reset();
+        result &= decoder.feed(INVALID[i], strlen(INVALID[i])) == PGD_ERROR;
+    }
+    decoder.reset();
+    result &= decoder.feed("[ ]", 3) == PGD_DONE && decoder.value().empty();
+
+    // unknown members and errors in later members give the same result as 'deserialize'
+    static const char *DOCUMENTS[] = {
+        "{\"x\": 1}",
+        "{\"x\":true }",
+        "{\"x\":\"a\"\n}",
+        "{\"x\":-1.5e3,\"name\":\"Ann\",\"y\":\"}\\\"\",\"id\":7,\"z\":false}",
+        "{\"owner\":{\"name\":\"A\", \"w\":null},\n \"v\":\"a\",\n\t\"people\":[{\"id\":1,\"u\":2}]}",
+        "{\"name\":\"A\",\n  \"x\":1,\n\t\"phones\": [{\"number\":\"1\"},\n   {\"number\":2}]}",
+        "{\"name\":\"A\",\n  \"phones\": [{\"number\":\"1\"},\n   {\"type\":true]}",
+        "{\"name\":\"A\",\n  \"id\": 5, \"x\":1 \"y\":2}",
+    };
+    for (size_t i = 0; i < sizeof(DOCUMENTS) / sizeof(DOCUMENTS[0]); ++i)
+    {
+        phonebook::Person expected;
+        Parameters params;
+        bool valid = expected.deserialize(DOCUMENTS[i], &params);
+        size_t length = strlen(DOCUMENTS[i]);
+        for (size_t chunk = 1; chunk <= length; chunk += length - 1)
+        {
+            PushDecoder<phonebook::Person> person;
+            for (size_t offset = 0; offset < length; offset += chunk)
+                person.feed(DOCUMENTS[i] + offset, std::min(chunk, length - offset));
+            if (valid)
+                result &= person.status() == PGD_DONE && person.value() == expected;
+            else
+                result &= person.status() == PGD_ERROR && person.error().code == params.error.code &&
+                    person.error().line == params.error.line && person.error().column == params.error.column;
+        }
+    }
+
+    std::cerr << "[TEST #14] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST15( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::vector<options::Cake> cakes(500);
+    for (size_t i = 0; i < cakes.size(); ++i)
+    {
+        cakes[i].name = "Cake #" + std::to_string(i);
+        cakes[i].weight = (uint32_t) i;
+        cakes[i].ingredients.push_back("flour");
+    }
+    std::string json;
+    bool result = serialize_array(cakes, json);
+
+    options::Cake cake;
+    size_t count = 0;
+    auto callback = [&]( options::Cake &item )
+    {
+        result &= item == cakes[count++];
+        return true;
+    };
+    result &= deserialize_array_each(cake, callback, json);
+    result &= count == cakes.size();
+
+    // generic streams and early stop
+    count = 0;
+    iterator_istream<std::string::const_iterator> is(json.begin(), json.end());
+    result &= deserialize_array_each(cake, [&]( options::Cake &item ) { return ++count < 10 && item.ingredients.size() == 1; }, is);
+    result &= count == 10;
+
+    count = 0;
+    Parameters params;
+    json.resize(json.size() / 2);
+    result &= !deserialize_array_each(cake, callback, json, &params) && !params.error;
+
+    std::cerr << "[TEST #15] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST16( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::string json;
+    std::back_insert_iterator<std::string> it(json);
+    iterator_ostream< std::back_insert_iterator<std::string> > os(it);
+    NdjsonWriter<options::Cake> writer(os);
+    options::Cake cake;
+    bool result = true;
+    for (int i = 0; i < 100; ++i)
+    {
+        cake.weight = i;
+        cake.name = "Cake #" + std::to_string(i);
+        result &= writer.write(cake);
+        if (i == 50) json += "{\"2\": 1} {}\n\r\n{\"2\": }\n";
+    }
+    result &= writer.count() == 100 && std::count(json.begin(), json.end(), '\n') == 103;
+
+    // the same lines written to a standard stream, a string and an output buffer
+    std::ostringstream stream;
+    std::string text, buffered = "[";
+    output_buffer ob(buffered);
+    NdjsonWriter<options::Cake> writer1(stream), writer2(text), writer3(ob);
+    for (int i = 0; i < 3; ++i)
+    {
+        cake.weight = i;
+        cake.name = "Cake #" + std::to_string(i);
+        result &= writer1.write(cake) && writer2.write(cake) && writer3.write(cake);
+    }
+    ob.flush();
+    result &= text.size() > 0 && text == json.substr(0, text.size()) && stream.str() == text &&
+        buffered == "[" + text && writer3.count() == 3;
+
+    // the error is cleared by the next message
+    {
+        Parameters params;
+        params.ensure_ascii = true;
+        std::string lines;
+        NdjsonWriter<options::Cake> writer4(lines, &params);
+        cake.name = "\xff";
+        result &= !writer4.write(cake) && writer4.error().code == PGERR_INVALID_VALUE && lines.empty();
+        cake.name = "Cake";
+        result &= writer4.write(cake) && writer4.error().code == PGERR_OK && writer4.count() == 1;
+    }
+
+    for (int skip = 0; skip < 2; ++skip)
+    {
+        NdjsonReader<options::Cake> reader(json.data(), json.size(), nullptr, skip != 0);
+        int count = 0;
+        while (reader.next())
+            result &= reader.value().weight == count++;
+        if (skip)
+            result &= count == 100 && reader.skipped() == 2 && reader.lines() == 103;
+        else
+            result &= count == 51 && reader.decoded() == 51 && reader.error().line == 52;
+    }
+
+    std::istringstream is(json);
+    NdjsonReader<options::Cake> reader(is, nullptr, true);
+    while (reader.next());
+    result &= reader.decoded() == 100 && reader.error().line == 54 && reader.error().column == 7;
+
+    std::cerr << "[TEST #16] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+// Message whose decoding throws an exception (see TEST17)
+struct Explosive {};
+
+namespace protogen_3_0_0 {
+
+template<>
+struct json<Explosive, void>
+{
+    static int read( json_context &, Explosive & ) { throw std::runtime_error("explosive"); }
+    static void clear( Explosive & ) {}
+};
+
+} // namespace protogen_3_0_0
+
+bool RUN_TEST17( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::string json;
+    std::back_insert_iterator<std::string> it(json);
+    iterator_ostream< std::back_insert_iterator<std::string> > os(it);
+    NdjsonWriter<options::Cake> writer(os);
+    options::Cake cake;
+    cake.ingredients.push_back("flour");
+    bool result = true;
+    const int COUNT = 20000;
+    for (int i = 0; i < COUNT; ++i)
+    {
+        cake.weight = i;
+        cake.name = "Cake #" + std::to_string(i);
+        result &= writer.write(cake);
+        if (i == 15000) json += "{\"2\": true}\n";
+    }
+
+    for (int ordered = 0; ordered < 2; ++ordered)
+    {
+        ParallelNdjsonReader<options::Cake> reader(4, nullptr, true, ordered != 0);
+        std::vector<bool> seen(COUNT);
+        int count = 0;
+        bool sequential = true;
+        result &= reader.read(json.data(), json.size(), [&]( options::Cake &item )
+        {
+            sequential &= item.weight == count;
+            seen[(size_t) (int) item.weight] = true;
+            ++count;
+            return true;
+        });
+        result &= count == COUNT && reader.skipped() == 1 && reader.error().line == 15002;
+        result &= std::count(seen.begin(), seen.end(), true) == COUNT;
+        if (ordered) result &= sequential;
+    }
+
+    ParallelNdjsonReader<options::Cake> reader(3);
+    int count = 0;
+    result &= !reader.read(json.data(), json.size(), [&]( options::Cake &item ) { return item.weight == count++; });
+    result &= count == 15001 && reader.error().line == 15002;
+    count = 0;
+    result &= reader.read(json.data(), json.size(), [&]( options::Cake & ) { return ++count < 10; });
+    result &= count == 10;
+
+    // exceptions of the callback and of the workers reach the caller after the threads are joined
+    bool thrown = false;
+    try
+    {
+        reader.read(json.data(), json.size(), []( options::Cake & ) -> bool { throw std::runtime_error("callback"); });
+    }
+    catch (const std::runtime_error &ex) { thrown = strcmp(ex.what(), "callback") == 0; }
+    result &= thrown;
+    thrown = false;
+    ParallelNdjsonReader<Explosive> explosive(4);
+    try
+    {
+        explosive.read(json.data(), json.size(), []( Explosive & ) { return true; });
+    }
+    catch (const std::runtime_error &ex) { thrown = strcmp(ex.what(), "explosive") == 0; }
+    result &= thrown;
+    count = 0;
+    result &= reader.read(json.data(), json.size(), [&]( options::Cake & ) { return ++count < 10; });
+    result &= count == 10;
+
+    std::cerr << "[TEST #17] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST18( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::vector<options::Cake> cakes(3);
+    cakes[1].name = "Chocolate";
+    cakes[2].weight = 500;
+    std::string json;
+    bool result = serialize_array(cakes, json);
+
+    static const char *FILE_NAME = "run-tests-18.json";
+    std::ofstream(FILE_NAME, std::ios::binary) << json;
+    std::vector<options::Cake> loaded;
+    result &= deserialize_array_file(loaded, FILE_NAME) && loaded == cakes;
+
+    std::ofstream(FILE_NAME, std::ios::binary) << "{\"1\": \"Vanilla\", \"2\": 300}";
+    options::Cake cake;
+    result &= cake.deserialize_file(FILE_NAME) && cake.name == "Vanilla" && cake.weight == 300;
+    std::remove(FILE_NAME);
+
+    Parameters params;
+    result &= !cake.deserialize_file(FILE_NAME, &params) && params.error.code == PGERR_INVALID_FILE;
+
+    #ifdef PROTOGEN_3_0_0__POSIX
+    // pipes have no size and are read instead of mapped
+    int fds[2];
+    result &= pipe(fds) == 0;
+    static const char *PIPED = "{\"1\": \"Lemon\", \"2\": 250}";
+    result &= write(fds[1], PIPED, strlen(PIPED)) == (ssize_t) strlen(PIPED);
+    close(fds[1]);
+    options::Cake piped;
+    result &= piped.deserialize_file("/dev/fd/" + std::to_string(fds[0])) && piped.name == "Lemon" &&
+        piped.weight == 250;
+    close(fds[0]);
+    #endif
+
+    std::cerr << "[TEST #18] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST19( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    static const char *JSON =
+        "{\"body\": {\"n\": [\"}\\\"]\", \"{\"], \"a\": [1.5]}, \"tag\": \"x\",\n"
+        " \"header\": {\"c\": 10, \"n\": \"text\", \"m\": tru}}";
+
+    bool result = true;
+    std::string json1;
+    for (int indexed = 0; indexed < 3; ++indexed)
+    {
+        Parameters params;
+        params.structural_index = indexed == 1;
+        types::Envelope envelope;
+        if (indexed == 2)
+        {
+            // generic input
+            std::string text(JSON);
+            iterator_istream<std::string::const_iterator> is(text.begin(), text.end());
+            result &= envelope.deserialize(is, &params);
+        }
+        else
+            result &= envelope.deserialize(JSON, strlen(JSON), &params);
+        result &= envelope.tag == "x" && envelope.header.pending() && envelope.body.pending();
+        result &= envelope.body->n.size() == 2 && envelope.body->n.front() == "}\"]" && !envelope.body.pending();
+
+        // invalid contents are only detected on access
+        result &= !envelope.header.decode(&params) && params.error.code == PGERR_INVALID_VALUE;
+        result &= envelope.header->c.empty();
+
+        envelope.header->c = 5;
+        std::string json2;
+        result &= envelope.serialize(json2);
+        if (indexed == 0)
+            json1 = json2;
+        else
+            result &= json1 == json2;
+    }
+
+    // const accessors can decode the text from several threads at once
+    types::Envelope shared;
+    result &= shared.deserialize(JSON, strlen(JSON));
+    const types::Envelope &view = shared;
+    std::atomic<int> matches(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i)
+        readers.emplace_back([&]{ if (view.body->n.size() == 2 && view.body->a.front() == 1.5) ++matches; });
+    for (auto &reader : readers) reader.join();
+    result &= matches == 4 && !view.body.pending();
+
+    // field masks select fields inside lazy fields, which are then decoded right away
+    {
+        FieldMask mask {"header.c"};
+        Parameters params;
+        params.mask = &mask;
+        types::Envelope envelope;
+        result &= envelope.deserialize("{\"header\": {\"c\": 10, \"n\": \"text\"}, \"tag\": \"x\"}", &params);
+        result &= !envelope.header.pending() && envelope.header->c == 10 && envelope.header->n.empty() &&
+            envelope.tag.empty();
+    }
+
+    // lazy fields keep the nesting levels left when the text was captured
+    for (int depth = 2; depth <= 3; ++depth)
+    {
+        Parameters params;
+        params.max_depth = depth;
+        types::Envelope envelope;
+        result &= envelope.deserialize("{\"body\": {\"a\": [1.5]}}", &params) && envelope.body.pending();
+        Parameters error;
+        if (depth == 2)
+            result &= !envelope.body.decode(&error) && error.error.code == PGERR_TOO_DEEP;
+        else
+            result &= envelope.body.decode(&error) && envelope.body->a.size() == 1;
+    }
+    static_assert(std::is_nothrow_move_constructible< lazy_field<types::Basic> >::value,
+        "lazy fields must be nothrow movable");
+
+    std::cerr << "[TEST #19] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    std::cerr << "   " << json1 << std::endl;
+    return result;
+}
+
+// counts heap allocations while enabled
+static bool COUNT_ALLOCATIONS = false;
+static size_t ALLOCATIONS = 0;
+
+void *operator new( size_t size )
+{
+    if (COUNT_ALLOCATIONS) ++ALLOCATIONS;
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete( void *ptr ) noexcept
+{
+    free(ptr);
+}
+
+template<typename T, typename... I>
+static size_t count_allocations( T &object, I&&... input )
+{
+    ALLOCATIONS = 0;
+    COUNT_ALLOCATIONS = true;
+    bool result = object.deserialize(std::forward<I>(input)...);
+    COUNT_ALLOCATIONS = false;
+    return result ? ALLOCATIONS : (size_t) -1;
+}
+
+// counts the heap allocations of 'build', used as a baseline for the standard library in use
+template<typename F>
+static size_t count_baseline( F &&build )
+{
+    ALLOCATIONS = 0;
+    COUNT_ALLOCATIONS = true;
+    build();
+    COUNT_ALLOCATIONS = false;
+    return ALLOCATIONS;
+}
+
+bool RUN_TEST20( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    // strings longer than any small string buffer
+    std::string text(40, 'x');
+    std::string json = "{\"name\":\"" + text + "\",\"id\":10,\"e-mail\":\"" + text + "\",\"phones\":[";
+    for (int i = 0; i < 3; ++i)
+        json += std::string(i ? "," : "") + "{\"number\":\"" + text + "\",\"type\":true}";
+    json += "],\"last_updated\":5}";
+
+    // at most one allocation per string and per list node, as if the message was built directly
+    size_t baseline = count_baseline([&text]
+        {
+            phonebook::Person expected;
+            expected.name = text;
+            expected.email = text;
+            for (int i = 0; i < 3; ++i)
+            {
+                expected.phones.emplace_back();
+                expected.phones.back().number = text;
+            }
+        });
+    phonebook::Person person;
+    size_t first = count_allocations(person, json);
+    bool result = first <= baseline;
+    // cleared strings keep their memory
+    person.clear();
+    result &= count_allocations(person, json) < first;
+    // generic input adds the tokenizer buffer, and strings exchange memory with the tokenizer
+    person.clear();
+    iterator_istream<std::string::const_iterator> is(json.begin(), json.end());
+    result &= count_allocations(person, is) <= first + 1;
+
+    // unknown values are skipped without allocations
+    types::Basic basic;
+    std::string json2 = "{\"a\":1.5,\"b\":2.5,\"c\":-3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,"
+        "\"i\":9,\"j\":10,\"k\":11,\"l\":12,\"m\":true,\"n\":\"short\",\"z\":[{\"x\":\"" + text + "\"}]}";
+    baseline = count_baseline([]{ types::Basic expected; expected.n = std::string("short"); });
+    result &= count_allocations(basic, json2) <= baseline;
+
+    options::Cake cake;
+    std::string json3 = "{\"1\":\"" + text + "\",\"2\":1,\"4\":[\"" + text + "\"]}";
+    baseline = count_baseline([&text]
+        {
+            options::Cake expected;
+            expected.name = text;
+            expected.ingredients.push_back(text);
+        });
+    result &= count_allocations(cake, json3) <= baseline;
+
+    std::cerr << "[TEST #20] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST21( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::string text(40, 'x');
+    std::string json = "{\"a\":1.5,\"c\":-3,\"m\":true,\"n\":\"" + text + "\",\"z\":[{\"x\":\"y\"}]}";
+    bool result = true;
+
+    for (int indexed = 0; indexed < 2; ++indexed)
+    {
+        Parameters params;
+        params.structural_index = indexed != 0;
+        Decoder decoder(&params);
+        Encoder encoder;
+        types::Basic basic;
+        std::string json2;
+        for (int i = 0; i < 3; ++i)
+        {
+            // no allocations once the buffers are warmed up
+            basic.clear();
+            ALLOCATIONS = 0;
+            COUNT_ALLOCATIONS = true;
+            result &= decoder.decode(basic, json) && encoder.encode(basic);
+            COUNT_ALLOCATIONS = false;
+            if (i > 0) result &= ALLOCATIONS == 0;
+            result &= basic.c == -3 && basic.n == text;
+            if (i == 0) basic.serialize(json2);
+            result &= encoder.output() == json2;
+        }
+        result &= !decoder.decode(basic, "{\"c\": x}") && decoder.error().code == PGERR_INVALID_VALUE;
+        result &= decoder.decode(basic, json) && decoder.error().code == PGERR_OK;
+
+        std::vector<types::Basic> items;
+        result &= decoder.decode(items, "[" + json + "," + json + "]") && items.size() == 2;
+        result &= encoder.encode(items) && encoder.output() == "[" + json2 + "," + json2 + "]";
+
+        // other outputs receive the contents of the buffer
+        std::string json3;
+        std::back_insert_iterator<std::string> it(json3);
+        iterator_ostream< std::back_insert_iterator<std::string> > os(it);
+        result &= encoder.encode(basic, os) && json3 == json2;
+        char json4[128] = {0};
+        result &= basic.serialize(json4, sizeof(json4) - 1) && json2 == json4;
+        result &= basic.serialize(json4, 4) && std::string(json4, 5) == json2.substr(0, 4) + json2[4];
+
+        // documents larger than the stream chunks
+        types::Basic large;
+        large.n = std::string(10000, 'x');
+        std::string json5 = "{}";
+        result &= large.serialize(json5) && json5.size() > 10000;
+        std::vector<char> json6 = {'{', '}'};
+        result &= large.serialize(json6) && std::string(json6.begin(), json6.end()) == json5;
+        std::ostringstream json7;
+        result &= large.serialize(json7) && "{}" + json7.str() == json5;
+        std::string json8 = "{}";
+        std::back_insert_iterator<std::string> it8(json8);
+        iterator_ostream< std::back_insert_iterator<std::string> > os8(it8);
+        result &= large.serialize(os8) && json8 == json5;
+    }
+
+    // obfuscated keys are revealed only once
+    Encoder encoder;
+    options::Cake cake;
+    cake.name = "Chocolate";
+    cake.weight = 500;
+    cake.ingredients.push_back("milk");
+    result &= encoder.encode(cake) && encoder.output() == "{\"4\":[\"milk\"],\"1\":\"Chocolate\",\"2\":500}";
+    ALLOCATIONS = 0;
+    COUNT_ALLOCATIONS = true;
+    result &= encoder.encode(cake);
+    COUNT_ALLOCATIONS = false;
+    result &= ALLOCATIONS == 0;
+
+    std::cerr << "[TEST #21] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST22( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::string text(300, 'x');
+    std::string json = "{\"a\": 1.5,\n \"n\": \"" + text + "\",\n \"z\": [{\"x\": \"y\"}]}";
+    static const char *FILE_NAME = "run-tests-22.json";
+    std::ofstream(FILE_NAME, std::ios::binary) << json;
+
+    bool result = true;
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        types::Basic basic;
+        if (mode == 0)
+        {
+            std::ifstream input(FILE_NAME, std::ios::binary);
+            result &= basic.deserialize(input);
+        }
+        else
+        if (mode == 1)
+        {
+            FILE *input = fopen(FILE_NAME, "rb");
+            file_istream is(input);
+            result &= basic.deserialize(is);
+            fclose(input);
+        }
+        #ifdef PROTOGEN_3_0_0__POSIX
+        else
+        {
+            int input = open(FILE_NAME, O_RDONLY);
+            fd_istream is(input);
+            result &= basic.deserialize(is);
+            close(input);
+        }
+        #endif
+        result &= basic.a == 1.5 && basic.n == text;
+    }
+
+    std::ofstream(FILE_NAME, std::ios::binary) << "{\"a\": 1.5,\n \"c\": x}";
+    FILE *input = fopen(FILE_NAME, "rb");
+    {
+        file_istream is(input);
+        Parameters params;
+        types::Basic basic;
+        result &= !basic.deserialize(is, &params) && params.error.code == PGERR_INVALID_VALUE;
+        result &= params.error.line == 2 && params.error.column == 7;
+    }
+    fclose(input);
+
+    // line breaks of iterator inputs are read as they are
+    {
+        std::string text2 = "\n{\"a\": 1.5,\n \"c\": x}";
+        iterator_istream<std::string::const_iterator> is(text2.begin(), text2.end());
+        Parameters params;
+        types::Basic basic;
+        result &= !basic.deserialize(is, &params) && params.error.line == 3 && params.error.column == 7;
+    }
+
+    // other inputs are copied character by character, whatever 'line' returns
+    {
+        struct string_istream : public istream
+        {
+            std::string text;
+            size_t pos = 0;
+            int peek() override { return (pos < text.size()) ? (unsigned char) text[pos] : 0; }
+            void next() override { if (pos < text.size()) ++pos; }
+            bool eof() const override { return pos >= text.size(); }
+            int line() const override { return 100; }
+            int column() const override { return (int) pos + 1; }
+        };
+        string_istream is;
+        is.text = "{\"a\": 1.5,\n \"c\": 2}";
+        types::Basic basic;
+        result &= basic.deserialize(is) && basic.a == 1.5 && basic.c == 2;
+        is.text = "{\"a\": 1.5,\n \"c\": x}";
+        is.pos = 0;
+        Parameters params;
+        result &= !basic.deserialize(is, &params) && params.error.line == 2 && params.error.column == 7;
+    }
+
+    #ifdef PROTOGEN_3_0_0__POSIX
+    {
+        // errors are reported without waiting for more input while the writer is still open
+        int fds[2];
+        result &= pipe(fds) == 0;
+        result &= write(fds[1], "{\"c\": ]", 8) == 8;
+        fd_istream is(fds[0]);
+        types::Basic basic;
+        result &= !basic.deserialize(is);
+        close(fds[1]);
+        close(fds[0]);
+    }
+    #endif
+
+    // documents on the same stream are read one at a time
+    std::string big(10000, 'y');
+    std::ofstream(FILE_NAME, std::ios::binary) << json << "\n{\"n\": \"" << big << "\", \"z\": [\"]\"]}{\"c\": 7}";
+    std::ifstream stream(FILE_NAME, std::ios::binary);
+    types::Basic first, second, third, fourth;
+    result &= first.deserialize(stream) && first.n == text && stream.good();
+    result &= second.deserialize(stream) && second.n == big && stream.good();
+    result &= third.deserialize(stream) && third.c == 7 && stream.good();
+    result &= !fourth.deserialize(stream) && stream.eof() && stream.fail();
+    std::istringstream strings("{\"c\": 1} {\"c\": 2}");
+    result &= first.deserialize(strings) && second.deserialize(strings) && first.c == 1 && second.c == 2;
+    std::istream detached(nullptr);
+    Parameters params;
+    result &= !fourth.deserialize(detached, &params) && detached.fail() && params.error.code == PGERR_INVALID_FILE;
+    std::remove(FILE_NAME);
+
+    std::cerr << "[TEST #22] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST23( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::string deep;
+    for (int i = 0; i < 5000; ++i) deep += "{\"x\":[";
+    for (int i = 0; i < 5000; ++i) deep += "]}";
+
+    bool result = true;
+    for (int indexed = 0; indexed < 2; ++indexed)
+    {
+        Parameters params;
+        params.structural_index = indexed != 0;
+        params.max_depth = 2;
+        types::Container container;
+        result &= container.deserialize("{\"a\": [1.5], \"n\": [\"x\"]}", &params);
+
+        // the array of messages adds one level
+        std::vector<types::Container> items;
+        result &= !deserialize_array(items, "[{\"a\": [1.5]}]", &params) && params.error.code == PGERR_TOO_DEEP;
+        result &= params.error.line == 1 && params.error.column == 8;
+        params.max_depth = 3;
+        result &= deserialize_array(items, "[{\"a\": [1.5]}]", &params) && items.size() == 1;
+
+        // the level count is restored after errors
+        params.max_depth = 1;
+        Decoder decoder(&params);
+        result &= !decoder.decode(container, "{\"a\": [1.5]}") && decoder.error().code == PGERR_TOO_DEEP;
+        result &= !decoder.decode(container, "{\"a\": [1.5]}") && decoder.error().code == PGERR_TOO_DEEP;
+        result &= decoder.decode(container, "{}");
+
+        // unknown values are skipped without recursion and are not limited
+        types::Basic basic;
+        result &= decoder.decode(basic, "{\"n\": \"text\", \"other\": " + deep + "}") && basic.n == "text";
+
+        // nested arrays count every level
+        std::vector< std::vector< std::vector<double> > > nested;
+        params.max_depth = 2;
+        result &= !deserialize_array(nested, "[[[1.5]]]", &params) && params.error.code == PGERR_TOO_DEEP;
+        result &= params.error.line == 1 && params.error.column == 3;
+        // elements being decoded are removed after errors, complete elements are kept
+        result &= nested.empty();
+        params.max_depth = 3;
+        result &= !deserialize_array(nested, "[[[1.5]], [[2.5], 3]]", &params) && nested.size() == 1 &&
+            nested[0].size() == 1 && nested[0][0][0] == 1.5;
+        nested.clear();
+        result &= deserialize_array(nested, "[[[1.5]]]", &params) && nested.size() == 1 &&
+            nested[0][0][0] == 1.5;
+
+        // deeply nested arrays are rejected before their contents are decoded
+        std::string arrays(5000, '[');
+        arrays += std::string(5000, ']');
+        params.max_depth = 2;
+        result &= !deserialize_array(nested, arrays, &params) && params.error.code == PGERR_TOO_DEEP &&
+            params.error.column == 3;
+        params.max_depth = 1;
+        result &= !container.deserialize("{\"a\": " + arrays + "}", &params) &&
+            params.error.code == PGERR_TOO_DEEP && params.error.column == 7;
+    }
+
+    std::cerr << "[TEST #23] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST24( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::string text(40, 'x');
+    std::string json = "{\"a\": [1.5, 2], \"m\": [true], \"n\": [\"" + text + "\"], \"o\": [1, 2, 3], \"u\": {\"v\": [1]}}";
+    bool result = true;
+    for (int indexed = 0; indexed < 2; ++indexed)
+    {
+        Parameters params;
+        params.structural_index = indexed != 0;
+        result &= types::Container::validate(json, &params);
+        // the message is not built (the structural index has its own buffers)
+        ALLOCATIONS = 0;
+        COUNT_ALLOCATIONS = true;
+        result &= types::Container::validate(json.data(), json.size(), &params);
+        COUNT_ALLOCATIONS = false;
+        result &= indexed || ALLOCATIONS == 0;
+
+        result &= !types::Container::validate("{\"a\": [1.5, \"2\"]}", &params) && params.error.code == PGERR_INVALID_VALUE;
+        result &= params.error.line == 1 && params.error.column == 13;
+        result &= !types::Container::validate("{\"m\": [true, 1]}", &params) && params.error.code == PGERR_INVALID_VALUE;
+        result &= !types::Container::validate("{\"n\": \"x\"}", &params) && params.error.code == PGERR_INVALID_ARRAY;
+        // non-repeated bytes fields are arrays of numbers
+        result &= !types::Container::validate("{\"o\": \"AQID\"}", &params) && params.error.code == PGERR_INVALID_ARRAY;
+        result &= !types::Container::validate("{\"o\": [1, 256]}", &params) && params.error.code == PGERR_INVALID_VALUE;
+        types::Container bytes;
+        bytes.o = {1, 2, 3};
+        std::string output;
+        result &= bytes.serialize(output) && output == "{\"o\":[1,2,3]}";
+        types::Container bytes2;
+        result &= bytes2.deserialize(output) && bytes2.o == bytes.o;
+        result &= !types::Container::validate("[]", &params) && params.error.code == PGERR_INVALID_OBJECT;
+        result &= !types::Container::validate("{\"a\": [1] \"b\": []}", &params) && params.error.code == PGERR_INVALID_OBJECT;
+
+        // lazy fields are validated as well
+        result &= types::Envelope::validate("{\"header\": {\"c\": 1}, \"body\": {\"a\": [1.5]}}", &params);
+        result &= !types::Envelope::validate("{\"header\": {\"c\": 1}, \"body\": {\"a\": [true]}}", &params);
+        result &= params.error.code == PGERR_INVALID_VALUE;
+
+        // field names follow the message options
+        result &= options::Cake::validate("{\"1\": \"Chocolate\", \"2\": 500, \"4\": [\"milk\"]}", &params);
+        result &= !options::Cake::validate("{\"1\": \"Chocolate\", \"2\": \"500\"}", &params);
+    }
+
+    std::cerr << "[TEST #24] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST25( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    static const char *JSON =
+        "{\"owner\": {\"name\": \"Michelle\", \"id\": 10, \"e-mail\": \"m@example.com\","
+        " \"phones\": [{\"number\": \"1234\", \"type\": true}, {\"number\": \"5678\"}]},"
+        " \"people\": [{\"name\": \"Bob\", \"id\": 20, \"phones\": [{\"number\": \"9\"}]}]}";
+
+    bool result = true;
+    for (int indexed = 0; indexed < 2; ++indexed)
+    {
+        Parameters params;
+        params.structural_index = indexed != 0;
+        FieldMask mask {"owner.name", "owner.phones.number", "people.phones"};
+        params.mask = &mask;
+        phonebook::AddressBook book;
+        result &= book.deserialize(JSON, &params);
+        result &= book.owner.name == "Michelle" && book.owner.id.empty() && book.owner.email.empty();
+        result &= book.owner.phones.size() == 2 && book.owner.phones.front().number == "1234";
+        result &= book.owner.phones.front().type.empty();
+        result &= book.people.size() == 1 && book.people.front().name.empty();
+        result &= book.people.front().phones.size() == 1 && book.people.front().phones.front().number == "9";
+
+        // skipped fields are still checked for syntax errors
+        std::string json = JSON;
+        json.replace(json.find("10"), 2, "[}");
+        result &= !book.deserialize(json, &params) && params.error.code == PGERR_IGNORE_FAILED;
+
+        // a field selects everything inside it
+        FieldMask mask2;
+        mask2.add("owner.phones").add("owner.phones.number").add("owner");
+        params.mask = &mask2;
+        phonebook::AddressBook book2;
+        result &= book2.deserialize(JSON, &params);
+        result &= book2.owner.id == 10 && book2.owner.phones.front().type == true && book2.people.empty();
+
+        Decoder decoder(&params);
+        result &= decoder.decode(book2, JSON) && book2.owner.email == "m@example.com" && book2.people.empty();
+
+        // paths use the JSON names of the fields
+        FieldMask mask3 {"owner.e-mail", "people.email"};
+        params.mask = &mask3;
+        phonebook::AddressBook book3;
+        result &= book3.deserialize(JSON, &params) && book3.owner.email == "m@example.com";
+        result &= book3.owner.name.empty() && book3.people.size() == 1 && book3.people.front().name.empty();
+        FieldMask mask4 {"4"};
+        params.mask = &mask4;
+        options::Cake cake;
+        result &= cake.deserialize("{\"1\": \"Cake\", \"4\": [\"milk\"]}", &params);
+        result &= cake.name.empty() && cake.ingredients.size() == 1;
+    }
+
+    std::cerr << "[TEST #25] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST26( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    std::string json =
+        "{\"people\": [{\"name\": \"Bob\", \"phones\": [{\"number\": \"1\"}, {\"number\": \"2\", \"type\": true}]},"
+        " {\"name\": \"Alice\", \"id\": 30}],"
+        " \"a/b\": {\"c~d\": 5}, \"owner\": {\"name\": \"Michelle\", \"e-mail\": \"m@example.com\"}}";
+
+    bool result = true;
+    for (int indexed = 0; indexed < 2; ++indexed)
+    {
+        Parameters params;
+        params.structural_index = indexed != 0;
+        std::string name;
+        result &= extract("/owner/name", name, json, &params) && name == "Michelle";
+        result &= extract("/owner/e-mail", name, json, &params) && name == "m@example.com";
+        result &= extract("/people/1/name", name, json, &params) && name == "Alice";
+        int id = 0;
+        result &= extract("/people/1/id", id, json, &params) && id == 30;
+        result &= extract("/a~1b/c~0d", id, json, &params) && id == 5;
+        phonebook::PhoneNumber phone;
+        result &= extract("/people/0/phones/1", phone, json, &params) && phone.number == "2" && phone.type == true;
+        phonebook::AddressBook book;
+        result &= extract("", book, json, &params) && book.owner.name == "Michelle";
+
+        result &= !extract("/people/2/name", name, json, &params) && params.error.code == PGERR_MISSING_FIELD;
+        result &= params.error.message == "no value at '/people/2'";
+        result &= !extract("/owner/id", name, json, &params) && params.error.code == PGERR_MISSING_FIELD;
+        result &= !extract("/people/x", name, json, &params) && params.error.code == PGERR_MISSING_FIELD;
+        result &= !extract("/people/01/name", name, json, &params) && params.error.code == PGERR_MISSING_FIELD;
+        name = "unchanged";
+        result &= !extract("/owner/id", id, "{\"owner\": {\"id\": null}}", &params) &&
+            params.error.code == PGERR_MISSING_FIELD;
+        result &= !extract("/owner/name", name, "{\"owner\": {\"name\": null}}", &params) &&
+            params.error.code == PGERR_MISSING_FIELD && name == "unchanged";
+        result &= !extract("/people/0/name", id, json, &params) && params.error.code == PGERR_INVALID_VALUE;
+        result &= !extract("owner", name, json, &params) && params.error.code == PGERR_INVALID_VALUE;
+
+        // the input after the value is not read
+        std::string partial = json.substr(0, json.find("Alice") + 7) + "[}";
+        result &= extract("/people/1/name", name, partial, &params) && name == "Alice";
+        result &= !extract("/people/1/id", id, partial, &params) && params.error.code != PGERR_OK;
+    }
+
+    std::cerr << "[TEST #26] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST27( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    static const int64_t VALUES[] = { 0, 1, -1, 9, 10, -10, 99, 100, 101, 999, 1000, 12345, -98765,
+        std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min(),
+        std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min() };
+
+    bool result = true;
+    Encoder encoder;
+    types::Container container;
+    std::string expected;
+    for (auto value : VALUES)
+    {
+        types::Basic basic;
+        basic.d = value;
+        basic.f = (uint64_t) value;
+        result &= encoder.encode(basic);
+        result &= encoder.output() == "{\"d\":" + std::to_string(value) + ",\"f\":" + std::to_string((uint64_t) value) + "}";
+        container.d.push_back(value);
+        expected += (expected.empty() ? "" : ",") + std::to_string(value);
+    }
+    result &= encoder.encode(container) && encoder.output() == "{\"d\":[" + expected + "]}";
+
+    // integers are formatted without temporary strings
+    ALLOCATIONS = 0;
+    COUNT_ALLOCATIONS = true;
+    result &= encoder.encode(container);
+    COUNT_ALLOCATIONS = false;
+    result &= ALLOCATIONS == 0;
+
+    types::Container container2;
+    result &= container2.deserialize(encoder.output()) && container2 == container;
+
+    std::cerr << "[TEST #27] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
+bool RUN_TEST28( int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    bool result = true;
+    flat::Point point;
+    point.x = 12;
+    point.s = "abc";
+    point.number = 3;
+    std::string json;
+    result &= point.serialize(json) && json == "{\"No\":3,\"s\":\"abc\",\"x\":12}";
+    flat::Point point3;
+    result &= point3.deserialize(json) && point3 == point;
+
+    PushDecoder<flat::Point> decoder;
+    result &= decoder.feed(json.c_str(), 5) == PGD_NEED_MORE;
+    result &= decoder.feed(json.c_str() + 5, json.length() - 5) == PGD_DONE && decoder.value() == point;
+
+    std::cerr << "[TEST #28] " << ((result) ? "Passed!" : "Failed!" ) << std::endl;
+    return result;
+}
+
 int main( int argc, char **argv)
 {
     bool result = true;
@@ -513,5 +1711,23 @@ int main( int argc, char **argv)
     result &= RUN_TEST8(argc, argv);
     result &= RUN_TEST9(argc, argv);
     result &= RUN_TEST10(argc, argv);
+    result &= RUN_TEST11(argc, argv);
+    result &= RUN_TEST12(argc, argv);
+    result &= RUN_TEST13(argc, argv);
+    result &= RUN_TEST14(argc, argv);
+    result &= RUN_TEST15(argc, argv);
+    result &= RUN_TEST16(argc, argv);
+    result &= RUN_TEST17(argc, argv);
+    result &= RUN_TEST18(argc, argv);
+    result &= RUN_TEST19(argc, argv);
+    result &= RUN_TEST20(argc, argv);
+    result &= RUN_TEST21(argc, argv);
+    result &= RUN_TEST22(argc, argv);
+    result &= RUN_TEST23(argc, argv);
+    result &= RUN_TEST24(argc, argv);
+    result &= RUN_TEST25(argc, argv);
+    result &= RUN_TEST26(argc, argv);
+    result &= RUN_TEST27(argc, argv);
+    result &= RUN_TEST28(argc, argv);
     return (int) !result;
 }